@@ -387,6 +387,46 @@ END
 
 def gen_makefile(name):
     games_no_Q2R = [game for game in games if game != "Q2R"]
+    # optional benchmark target using a stub engine (tools/bench.cpp)
+    bench_vars = ""
+    bench_help = ""
+    bench_rules = ""
+    if os.path.exists("tools/bench.cpp"):
+        bench_vars = """
+BENCH_DIR := tools
+BENCH_BIN := stripper_bench
+BENCH_SRC_FILES := $(filter-out $(SRC_DIR)/main.cpp,$(SRC_FILES)) $(BENCH_DIR)/bench.cpp $(BENCH_DIR)/mock_engine.cpp
+BENCH_CPPFLAGS := -I ./include -I $(BENCH_DIR) -I $(BENCH_DIR)/mock -DGAME_MOCK -DNDEBUG
+BENCH_CFLAGS := -Wall -pipe -O2 -pthread
+"""
+        bench_help = "\t@echo bench: [benchmark using a stub engine, see tools/bench.cpp]\n"
+        bench_rules = """
+bench: $(BIN_DIR)/bench/$(BENCH_BIN)
+
+$(BIN_DIR)/bench/$(BENCH_BIN): $(BENCH_SRC_FILES) $(wildcard include/*.h) $(wildcard $(BENCH_DIR)/*.h) $(wildcard $(BENCH_DIR)/mock/*.h)
+\tmkdir -p $(@D)
+\t$(CC) $(BENCH_CPPFLAGS) $(BENCH_CFLAGS) -o $@ $(BENCH_SRC_FILES)
+"""
+    # optional command line tool using the same stub engine (tools/cli.cpp)
+    cli_vars = ""
+    cli_help = ""
+    cli_rules = ""
+    if os.path.exists("tools/cli.cpp"):
+        cli_vars = """
+CLI_DIR := tools
+CLI_BIN := stripper_cli
+CLI_SRC_FILES := $(filter-out $(SRC_DIR)/main.cpp,$(SRC_FILES)) $(CLI_DIR)/cli.cpp $(CLI_DIR)/mock_engine.cpp
+CLI_CPPFLAGS := -I ./include -I $(CLI_DIR) -I $(CLI_DIR)/mock -DGAME_MOCK -DNDEBUG
+CLI_CFLAGS := -Wall -pipe -O2 -pthread
+"""
+        cli_help = "\t@echo cli: [offline tool to apply configs to entity dumps, see tools/cli.cpp]\n"
+        cli_rules = """
+cli: $(BIN_DIR)/cli/$(CLI_BIN)
+
+$(BIN_DIR)/cli/$(CLI_BIN): $(CLI_SRC_FILES) $(wildcard include/*.h) $(wildcard $(CLI_DIR)/*.h) $(wildcard $(CLI_DIR)/mock/*.h)
+\tmkdir -p $(@D)
+\t$(CC) $(CLI_CPPFLAGS) $(CLI_CFLAGS) -o $@ $(CLI_SRC_FILES)
+"""
     with open(f"Makefile", "w", encoding="utf-8") as f:
         f.write(
             f"""# STUB_QMM - Example QMM Plugin
@@ -410,8 +450,8 @@ SRC_FILES := $(wildcard $(SRC_DIR)/*.cpp)
 OBJ_FILES := $(SRC_FILES:$(SRC_DIR)/%.cpp=%.o)
 
 CPPFLAGS := -MMD -MP -I ./include -isystem ../qmm_sdks -isystem ../qmm2/include
-CFLAGS   := -Wall -pipe -fPIC
-LDFLAGS  := -shared -fPIC
+CFLAGS   := -Wall -pipe -fPIC -pthread
+LDFLAGS  := -shared -fPIC -pthread
 LDLIBS   :=
 
 REL_CPPFLAGS := $(CPPFLAGS) -DNDEBUG -DNDEBUG
@@ -426,8 +466,8 @@ REL_LDFLAGS_32 := $(LDFLAGS) -m32
 REL_LDFLAGS_64 := $(LDFLAGS)
 DBG_LDFLAGS_32 := $(LDFLAGS) -m32 -g -pg
 DBG_LDFLAGS_64 := $(LDFLAGS) -g -pg
-
-.PHONY: help all clean release debug release32 debug32 release64 debug64 $(addprefix game-,$(GAMES)) $(addprefix release-,$(GAMES)) $(addprefix debug-,$(GAMES))
+{bench_vars}{cli_vars}
+.PHONY: help all clean bench cli release debug release32 debug32 release64 debug64 $(addprefix game-,$(GAMES)) $(addprefix release-,$(GAMES)) $(addprefix debug-,$(GAMES))
 
 help:
 	@echo make targets:
@@ -445,7 +485,7 @@ help:
 	@echo release64-[GAME]: [64-bit release build for GAME]
 	@echo debug32-[GAME]: [32-bit debug build for GAME]
 	@echo debug64-[GAME]: [64-bit release build for GAME]
-
+{bench_help}{cli_help}
 all: release debug
 release: release32 release64
 release32: $(addprefix release32-,$(GAMES))
@@ -501,7 +541,7 @@ $(OBJ_DIR)/debug-$(1)/x86_64/%.o: $(SRC_DIR)/%.cpp
 -include $$(addprefix $(OBJ_DIR)/debug-$(1)/x86_64/,$(OBJ_FILES:.o=.d))
 endef
 $(foreach game,$(GAMES),$(eval $(call gen_rules,$(game))))
-
+{bench_rules}{cli_rules}
 clean:
 	@$(RM) -rv $(BIN_DIR) $(OBJ_DIR)
 """
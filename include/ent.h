@@ -12,81 +12,224 @@ Created By:
 #ifndef STRIPPER_QMM_ENT_H
 #define STRIPPER_QMM_ENT_H
 
+#include <cstdint>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <string>
-
-// this represents a single entity
+#include <string_view>
+#include <memory>
+#include "strpool.h"
+
+// this represents a single entity. keys and vals are ids into the owning MapEntities' StringPool. they are
+// stored as parallel arrays sorted by key string (the same order the old std::map used), so lookups only walk
+// the small keys array and a val is only touched once its key is found. keysig has 1 bit set per key (see
+// key_bit) to reject most lookups for missing keys early
 struct Ent {
-	std::string classname; // classname is stored when encountered for easier retrieval
-	std::map<std::string, std::string> keyvals;
+    public:
+        StrId classname = str_empty; // classname is stored when encountered for easier retrieval
+        uint32_t keysig = 0;
+        std::vector<StrId> keys;
+        std::vector<StrId> vals;
+
+        // return the val for key, or nullptr if key doesn't exist
+        const StrId* get(StrId key) const;
+        // set the val for key, adding key in sorted position if it doesn't exist
+        void set(const StringPool& pool, StrId key, StrId val);
+        // remove key, returns true if it existed
+        bool erase(StrId key);
+
+        size_t size() const { return this->keys.size(); }
+        bool empty() const { return this->keys.empty(); }
+
+        // return the keysig bit for a key
+        static uint32_t key_bit(StrId key) { return 1u << (key & 31); }
 };
 
+// compiled "filter"/"replace" masks and configs, see rules.h
+struct BoundMatcher;
+struct RuleProgram;
+
 // typedefs for common types used in MapEntities
-typedef std::vector<std::string> TokenList;
-typedef std::vector<Ent> EntList;
+// entities are never changed once they are in an EntList, so copies of a list (like the map and mod entity lists)
+// share every entity that hasn't been changed since. see MapEntities::edit_ent()
+typedef std::vector<std::shared_ptr<const Ent>> EntList;
 typedef std::string EntString;
+// sorted positions of entities in an EntList
+typedef std::vector<size_t> EntPosList;
+// maps a val to the positions of all entities with that val for a single key
+typedef std::unordered_map<StrId, EntPosList> KeyIndex;
+// keyvals of an entity block from a config file. these are kept as strings (sorted by key, last val wins,
+// just like a map entity) since most of them never need to be added to a map's StringPool
+typedef std::map<std::string, std::string> KeyValMap;
+
+// position of the next token to pass to the mod from an EntList. tokens are generated on demand
+// instead of storing a copy of every key and val as a separate string
+struct TokenCursor {
+    enum Phase {
+        phase_open,     // "{" of entity
+        phase_key,      // key of keyval
+        phase_val,      // val of keyval
+        phase_close,    // "}" of entity
+    };
+
+    size_t ent = 0;
+    size_t keyval = 0;
+    Phase phase = phase_open;
+};
+
+// a change to a key's val on a single entity, logged while running a "replace" mask so the indexes can be updated
+// all at once afterwards
+struct IndexChange {
+    StrId key;
+    size_t pos;
+    StrId oldval;
+    StrId newval;
+    bool has_oldval;
+    bool has_newval;
+};
+
+// a copy of an entity list that can be serialized on another thread while the original keeps changing. entities
+// are shared with the original, which copies any entity before changing it
+struct EntSnapshot {
+    std::shared_ptr<StringPool> pool;           // keeps string storage alive
+    std::vector<std::string_view> strings;      // copy of the pool's string table, see StringPool::get_strings()
+    EntList entlist;
+};
 
 // this represents a map's worth of entities
 struct MapEntities {
     public:
-        // need constructors/assignment operators to handle re-initialization of iterator member
         MapEntities();
+        // use a shared StringPool (e.g. all entity lists for a single map load)
+        MapEntities(std::shared_ptr<StringPool> pool);
         MapEntities(const MapEntities& other);
         MapEntities& operator=(const MapEntities& other);
         MapEntities(MapEntities&& other) noexcept;
         MapEntities& operator=(MapEntities&& other) noexcept;
 
         // populate MapEntities from entstring
-        void make_from_entstring(EntString entstring);
+        void make_from_entstring(std::string_view entstring);
         // populate MapEntities from engine tokens
         void make_from_engine();
 
         // load and parse config file and apply to ents
         void apply_config(std::string file);
+        // apply an already loaded config to ents (file is only used for logging)
+        void apply_config(const RuleProgram& program, std::string file);
+        // run rules [begin, end) from a compiled config against the ents without logging, adding to the counts of
+        // affected entities (file is used for profiling). running a config in parts gives the same result as
+        // running it all at once
+        void apply_rules(const RuleProgram& program, const std::string& file, size_t begin, size_t end, int& num_filtered, int& num_added, int& num_replaced);
         // add keyval to all entities
         void add_keyval(std::string key, std::string val);
 
         // return the next token
         intptr_t get_next_token(char* buf, intptr_t len);
 
-        // return tokenlist
-        const TokenList& get_tokenlist();
         // return entlist
         const EntList& get_entlist();
         // return entstring
         const EntString& get_entstring();
+        // return string pool that entlist's ids refer to
+        const StringPool& get_pool();
+
+        // return hash of the entstring or engine tokens this list was made from
+        uint64_t get_source_hash() const;
 
         // dump entlist to file
         void dump_to_file(std::string file, bool append = false);
+        // append entlist to buf in the same format as dump_to_file
+        void dump_to_buffer(std::string& buf) const;
+        // return a copy of entlist for dump_snapshot() (entities are shared, not copied)
+        EntSnapshot get_snapshot() const;
+        // append a snapshot to buf in the same format as dump_to_file. safe to call on any thread
+        static void dump_snapshot(const EntSnapshot& snapshot, std::string& buf);
+        // append a summary of the changes from this entity list to modents (which must use the same string pool) to
+        // buf, in config format: "filter" blocks for removed entities, "replace"/"with" pairs for changed entities,
+        // and "add" blocks for new entities. unchanged entities are found by hashing their keyvals, and changed
+        // entities are paired by their origin, targetname, model, or classname. this is meant for reviewing changes,
+        // and applying it doesn't always give modents: masks leave out empty and /regex/ vals and can match other
+        // entities, and entity order isn't kept. a warning is logged for each change that won't be reproduced
+        void dump_delta(const MapEntities& modents, std::string& buf) const;
+        // write a buffer made by dump_snapshot() to file
+        static void write_dump(std::string file, std::string_view buf, bool append = false);
+
+        // populate MapEntities from a cache file written with save_cache. returns false if the file doesn't
+        // exist or was saved with a different key
+        bool load_cache(std::string file, uint64_t key);
+        // save entlist to a cache file, along with a key that identifies the inputs used to generate it
+        void save_cache(std::string file, uint64_t key);
+        // replace each entity with other's copy of an identical entity, if it has one, so they are shared again (e.g.
+        // after loading from a cache). other must use the same string pool
+        void share_ents(const MapEntities& other);
 
     private:
-        TokenList tokenlist;
+        // pool is shared between copies, since it is append-only
+        std::shared_ptr<StringPool> pool;
+
         EntList entlist;
         EntString entstring;
 
-        TokenList::iterator tokeniter;
-
-        // returns true if "test" has all the same keyvals that "contains" has
-        static bool is_ent_match(Ent& test, Ent& contains);
-        // removes all matching entities from list
-        int filter_ents(Ent& filterent);
-        // adds an entity to list (puts worldspawn at the beginning)
-        int add_ent(Ent& addent);
-        // finds all entities in list matching all stored replaceents and replaces with a withent
-        int replace_ents(EntList& replace_entlist, Ent& withent);
-        // replaces all applicable keyvals on an ent
-        static void replace_ent(Ent& replaceent, Ent& withent);
-
-        // generate a tokenlist from entstring
-        static TokenList tokenlist_from_entstring(const EntString& entstring);
-        // generate a tokenlist from engine tokens
-        static TokenList tokenlist_from_engine();
-        // generate a tokenlist from entlist
-        static TokenList tokenlist_from_entlist(const EntList& entlist);
-        // generate an entlist from engine tokens
-        static EntList entlist_from_tokenlist(const TokenList& tokenlist);
+        // hash of the entstring or engine tokens entlist was made from
+        uint64_t source_hash = 0;
+
+        // position of next token for get_next_token(). restarts at the first token after entlist changes
+        TokenCursor tokencursor;
+
+        // entstring is generated from entlist on first access, and regenerated on the next access after
+        // entlist changes
+        bool entstring_dirty = true;
+
+        // per-key indexes of val -> entity positions. these are only built (lazily) for keys that
+        // are used in exact-match predicates, and are kept up to date as entities are changed
+        std::unordered_map<StrId, KeyIndex> indexes;
+        // changes made by replace_ent() that haven't been applied to the indexes yet
+        std::vector<IndexChange> index_changes;
+
+        // structural edits made while running rules are logged instead of shifting entlist around, so
+        // entity positions stay stable until compact(). removed entities are tombstoned, and added
+        // entities are always appended (with worldspawn positions logged to be moved to the beginning)
+        std::vector<bool> removed;
+        size_t num_removed = 0;
+        EntPosList prepends;
+
+        // apply structural edits logged while running rules
+        void compact();
+
+        // return the index for key, building it if needed
+        KeyIndex& get_index(StrId key);
+        // find candidate positions for a matcher by intersecting the indexes of its exact-match
+        // predicates. returns false if the matcher has no exact-match predicates
+        bool find_candidates(const BoundMatcher& matcher, EntPosList& candidates);
+        // update indexes after the val of key on the entity at pos changes (nullptr = no val)
+        void update_index(size_t pos, StrId key, const StrId* oldval, const StrId* newval);
+        // apply index_changes. each affected position list is only rebuilt once, instead of inserting and erasing a
+        // position per changed entity
+        void apply_index_changes();
+
+        // return the entity at pos for changing. an entity that is shared with another list is copied first
+        Ent& edit_ent(size_t pos);
+        // mark entstring as out of date and reset token cursor after entlist changes
+        void mark_dirty();
+        // test entities against matchers (in parallel if worker threads are enabled). matched[i] is set if the
+        // entity at positions[i] (or at i if positions is nullptr) isn't removed and matches any of matchers
+        void match_ents(const std::vector<const BoundMatcher*>& matchers, const EntPosList* positions, std::vector<uint8_t>& matched);
+        // removes all entities matching any of the filter masks from list
+        int filter_ents(const std::vector<BoundMatcher>& filter_list);
+        // adds an entity to list (puts worldspawn at the beginning, once compacted)
+        int add_ent(const KeyValMap& addent);
+        // finds all entities in list matching any stored replace masks and replaces with a withent
+        int replace_ents(const std::vector<BoundMatcher>& replace_list, const KeyValMap& withent);
+        // replaces all applicable keyvals on the ent at pos. withent is a list of interned key/val pairs. index
+        // updates are logged to index_changes
+        void replace_ent(size_t pos, const std::vector<std::pair<StrId, StrId>>& withent);
+
+        // generate an entlist from entstring
+        static EntList entlist_from_entstring(StringPool& pool, std::string_view entstring);
+        // generate an entlist from engine tokens, and hash the tokens
+        static EntList entlist_from_engine(StringPool& pool, uint64_t& hash);
         // generate an entstring from entlist
-        static EntString entstring_from_entlist(const EntList& entlist);
+        static EntString entstring_from_entlist(const StringPool& pool, const EntList& entlist);
 };
 #endif // STRIPPER_QMM_ENT_H
@@ -30,6 +30,7 @@ Created By:
 #elif defined(GAME_JAMP)
     #include <jamp/game/g_local.h>
     #define GAME_HAS_SUBBSP
+    #define GAME_HAS_FS_GETFILELIST
     #define GAME_STR "JAMP"
 #elif defined(GAME_JASP)
     #include <jasp/game/q_shared.h>
@@ -41,6 +42,7 @@ Created By:
     #define GAME_STR "JASP"
 #elif defined(GAME_JK2MP)
     #include <jk2mp/game/g_local.h>
+    #define GAME_HAS_FS_GETFILELIST
     #define GAME_STR "JK2MP"
 #elif defined(GAME_JK2SP)
     #include <jk2sp/game/q_shared.h>
@@ -81,9 +83,11 @@ Created By:
     #define GAME_STR "Q2R"
 #elif defined(GAME_Q3A)
     #include <q3a/game/g_local.h>
+    #define GAME_HAS_FS_GETFILELIST
     #define GAME_STR "Q3A"
 #elif defined(GAME_RTCWMP)
     #include <rtcwmp/game/g_local.h>
+    #define GAME_HAS_FS_GETFILELIST
     #define GAME_STR "RTCWMP"
 #elif defined(GAME_RTCWSP)
     #include <rtcwsp/game/g_local.h>
@@ -121,7 +125,12 @@ Created By:
     #define GAME_STR "STVOYSP"
 #elif defined(GAME_WET)
     #include <wet/game/g_local.h>
+    #define GAME_HAS_FS_GETFILELIST
     #define GAME_STR "WET"
+#elif defined(GAME_MOCK)
+    // stub engine for tools/ (benchmark, etc), see tools/mock/
+    #include <game_mock.h>
+    #define GAME_STR "MOCK"
 #else
 	#error Unknown engine!
 #endif
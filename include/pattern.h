@@ -0,0 +1,101 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+#ifndef STRIPPER_QMM_PATTERN_H
+#define STRIPPER_QMM_PATTERN_H
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <regex>
+#include <bitset>
+
+// a state in a Pattern's NFA
+struct NfaState {
+    enum Type {
+        nfa_set,        // consume 1 char in set, then go to out
+        nfa_split,      // go to both out and out1 without consuming a char
+        nfa_match,      // end of pattern
+    };
+
+    Type type;
+    int set;            // index into Pattern::sets
+    int out;
+    int out1;
+};
+
+// a compiled regex that is always matched against an entire string (like std::regex_match). patterns use
+// ECMAScript syntax, just like std::regex. patterns that are really plain strings, or plain strings joined by
+// ".*" (like "weapon_.*"), are matched with simple string checks. other patterns are compiled to a DFA (or
+// simulated as an NFA if the DFA would be too big), which match in linear time. patterns using features that
+// aren't supported here (anchors, backreferences, lookaheads, etc) fall back to std::regex
+struct Pattern {
+    public:
+        // compile a pattern. returns false and sets error if the pattern is invalid
+        bool compile(const std::string& pattern, std::string& error);
+
+        // returns true if all of str matches the pattern
+        bool match(std::string_view str) const;
+
+        // append the compiled pattern to buf, so it can be loaded without compiling it again (see
+        // RuleProgram::save_binary)
+        void save(std::string& buf) const;
+        // load a pattern written by save(), and advance data past it. source is the pattern it was compiled from,
+        // since std::regex patterns have to be compiled again. returns false and sets error if data is invalid
+        bool load(std::string_view& data, const std::string& source, std::string& error);
+
+        // returns true if the pattern only matches a single string, which is stored in literal
+        bool is_literal() const { return this->kind == kind_literal; }
+        const std::string& get_literal() const { return this->literal; }
+
+    private:
+        enum Kind {
+            kind_literal,   // plain string
+            kind_glob,      // plain strings joined by ".*"
+            kind_dfa,       // DFA
+            kind_nfa,       // NFA simulation
+            kind_regex,     // std::regex
+        };
+        Kind kind = kind_literal;
+
+        // kind_literal
+        std::string literal;
+
+        // kind_glob: parts must appear in order, with the first at the beginning of the string (unless glob_start)
+        // and the last at the end of the string (unless glob_end). parts never contain newlines, since "."
+        // doesn't match them
+        std::vector<std::string> parts;
+        bool glob_start = false;
+        bool glob_end = false;
+
+        // kind_dfa: bytes are mapped to classes that always have the same transitions. state 0 is the dead state
+        uint8_t classes[256] = {};
+        int num_classes = 0;
+        std::vector<int> table;         // table[state * num_classes + class] = next state
+        std::vector<bool> accept;
+        int dfa_start = 0;
+
+        // kind_nfa (and used to build the DFA)
+        std::vector<std::bitset<256>> sets;
+        std::vector<NfaState> nfa;
+        int nfa_start = 0;
+
+        // kind_regex
+        std::regex regex;
+
+        bool match_glob(std::string_view str) const;
+        bool match_nfa(std::string_view str) const;
+        // build DFA from nfa, returns false if it has too many states
+        bool build_dfa();
+};
+
+#endif // STRIPPER_QMM_PATTERN_H
@@ -0,0 +1,167 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+#ifndef STRIPPER_QMM_RULES_H
+#define STRIPPER_QMM_RULES_H
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <memory>
+#include "ent.h"
+#include "pattern.h"
+#include "stats.h"
+#include "strpool.h"
+
+// keyvals of an entity block while a config is being compiled, as views into the config text. sorted by key with
+// duplicate keys removed (last val wins), just like a KeyValMap
+typedef std::vector<std::pair<std::string_view, std::string_view>> KeyValViews;
+
+// a single key/val test from a "filter" or "replace" mask
+struct Predicate {
+    // ordered from cheapest to most expensive, since predicates are tested in this order
+    enum Type {
+        pred_exact,     // key must exist with exactly this val
+        pred_absent,    // key must not exist (or have an empty val)
+        pred_regex,     // key must exist and its val must fully match a regex
+    };
+
+    Type type;
+    std::string key;
+    std::string val;    // exact val, or regex pattern with the surrounding "/" removed
+    Pattern regex;
+};
+
+// a Predicate with its key and val resolved to ids in a specific StringPool
+struct BoundPredicate {
+    Predicate::Type type;
+    StrId key;
+    StrId val;
+    const Pattern* regex;
+};
+
+// a Matcher bound to a specific StringPool, so key and val comparisons are just id comparisons
+struct BoundMatcher {
+    public:
+        std::vector<BoundPredicate> preds;
+        // set if an exact-match val or a required key is not in the pool, so no entity can match
+        bool never = false;
+        // if set, match() records counts and timings here
+        BlockProfile* profile = nullptr;
+
+        // returns true if ent passes every predicate. a matcher with no predicates matches all entities
+        bool match(const Ent& ent, const StringPool& pool) const;
+
+    private:
+        // match() with profiling
+        bool match_profiled(const Ent& ent, const StringPool& pool) const;
+};
+
+// a "filter" or "replace" mask compiled into a list of predicates
+struct Matcher {
+    public:
+        // line in the config file where the mask entity starts
+        int line = 0;
+
+        // compile a mask entity. returns false and sets error if a regex failed to compile
+        bool compile(const KeyValViews& mask, std::string& error);
+        // add a predicate that was already compiled and sorted by compile() (see RuleProgram::load_binary)
+        void add(Predicate pred);
+
+        // return the compiled predicates, in the order they are tested
+        const std::vector<Predicate>& get_preds() const { return this->preds; }
+
+        // resolve keys and vals to ids in pool. the Matcher must outlive the returned BoundMatcher
+        BoundMatcher bind(const StringPool& pool) const;
+
+    private:
+        std::vector<Predicate> preds;
+};
+
+// a single step of a compiled config
+struct Rule {
+    enum Type {
+        rule_filter,    // remove entities matching any of filter (consecutive "filter" entities are merged)
+        rule_add,       // add ent as a new entity
+        rule_replace,   // set ent's keyvals on entities matching any of replace
+    };
+
+    Type type;
+    std::vector<Matcher> filter;
+    std::vector<Matcher> replace;
+    KeyValMap ent;
+    // line in the config file where the "add" or "with" entity starts
+    int line = 0;
+    // hash of the masks and entity (not line numbers), to find the rules that changed between two versions of a
+    // config
+    uint64_t hash = 0;
+};
+
+// a config file compiled into a list of rules that are run in order against a map's entities
+struct RuleProgram {
+    public:
+        std::vector<Rule> rules;
+
+        // hash and size of the config file contents
+        uint64_t hash = 0;
+        uint64_t source_size = 0;
+
+        // count how many entities were loaded from the config
+        int num_filters = 0, num_adds = 0, num_replaces = 0, num_withs = 0;
+
+        // warnings generated while compiling, in the order they were found
+        std::vector<std::string> warnings;
+
+        // compile config text into rules
+        void compile(std::string_view text);
+
+        // write the compiled config to buf as a binary rule file. strings are stored once in a table, masks are
+        // stored as already sorted predicates, and regexes are stored compiled (as plain strings, globs, or DFA/NFA
+        // tables), so loading it needs no tokenizing, sorting, or regex compiling (except for std::regex fallbacks)
+        void save_binary(std::string& buf) const;
+        // load a compiled config from a binary rule file made by save_binary(). hash and source_size are set to
+        // those of the config it was made from. returns false if the file is invalid or from a different format version
+        bool load_binary(std::string_view data);
+        // return the binary rule file for a config file ("maps/mapname.ini" -> "maps/mapname.bin")
+        static std::string binary_file(const std::string& file);
+        // compile a config file and write its binary rule file. returns false if either file couldn't be opened
+        static bool compile_file(const std::string& file);
+
+        // return the compiled config for a file, or nullptr if it couldn't be loaded. compiled configs are
+        // cached for the life of the process by path and content hash, and only recompiled if the file changes.
+        // if the file's binary rule file was made from a config of the same size, it is loaded instead, without
+        // reading the config (but see precompile()). the config's warnings are logged on every load, not just when
+        // it is compiled
+        static std::shared_ptr<const RuleProgram> load(const std::string& file);
+
+        // return the compiled config for a file (or from its binary rule file, like load()) without caching it or
+        // logging its warnings, or nullptr if the file couldn't be read. it only uses the engine's file functions, so
+        // it can be used from several threads with an engine that allows that (like the stub engine in tools/)
+        static std::shared_ptr<const RuleProgram> load_file(const std::string& file);
+
+        // read config files and start compiling them on a background thread, so load() can return them without
+        // compiling. files that can't be read are skipped. warnings are logged by poll_precompile() once compiling
+        // finishes (unless the file was loaded first), and again by each load(). binary rule files are checked
+        // against the whole config here, and one that is out of date isn't used by load() either
+        static void precompile(const std::vector<std::string>& files);
+        // log warnings for background compiles that have finished. returns true while any are still compiling
+        static bool poll_precompile();
+        // wait for any background compile to finish (before unloading)
+        static void wait_precompile();
+
+    private:
+        // add a printf-style warning message
+        void warn(const char* fmt, ...);
+};
+
+#endif // STRIPPER_QMM_RULES_H
@@ -0,0 +1,86 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+#ifndef STRIPPER_QMM_STATS_H
+#define STRIPPER_QMM_STATS_H
+
+#include <cstdint>
+#include <chrono>
+#include <string>
+
+// high-resolution timer, starts when constructed
+struct StatTimer {
+    public:
+        StatTimer() : start(std::chrono::steady_clock::now()) { }
+
+        // return milliseconds since timer was started
+        double ms() const { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - this->start).count(); }
+
+    private:
+        std::chrono::steady_clock::time_point start;
+};
+
+// number of recent samples (usually 1 per map load) that min/avg/max are calculated from
+const int stats_window = 16;
+
+// a value (time or count) recorded once per map load, with min/avg/max over the most recent samples
+struct RollingStat {
+    public:
+        // record a new sample
+        void add(double value);
+
+        double last() const { return this->samples[(this->next + stats_window - 1) % stats_window]; }
+        double min() const;
+        double avg() const;
+        double max() const;
+        // return number of samples in the window
+        int size() const { return this->count < stats_window ? this->count : stats_window; }
+        // return total number of samples ever recorded
+        int total() const { return this->count; }
+
+    private:
+        double samples[stats_window] = {};
+        int next = 0;
+        int count = 0;
+};
+
+// record time in milliseconds for a stage
+void stats_time(const char* stage, double ms);
+// record a count (entities, tokens, etc)
+void stats_count(const char* counter, double value);
+
+// print all stats to the log
+void stats_print();
+
+// profiling counters for a single block of a config file
+struct BlockProfile {
+    std::string file;
+    int line = 0;
+    const char* type = "";      // "filter", "add", "replace", or "with"
+    int64_t tested = 0;         // entities tested against a "filter" or "replace" block
+    int64_t matched = 0;        // entities matched by a "filter" or "replace" block, or added/replaced by an "add"/"with" block
+    double ms = 0;              // time spent on the block ("with" blocks include their "replace" blocks)
+    int64_t regex_tested = 0;   // regex predicates tested
+    double regex_ms = 0;        // time spent testing regex predicates (included in ms)
+};
+
+// turn per-block profiling of configs on or off
+void profile_enable(bool enable);
+bool profile_enabled();
+// clear all block profiles (at the start of each map load)
+void profile_clear();
+// return the profile for a config block, adding it if needed. blocks are identified by file, line, and type, so
+// counters are combined if a config is applied more than once (e.g. to SubBSPs). pointer is valid until profile_clear()
+BlockProfile* profile_block(const std::string& file, int line, const char* type);
+// print block profiles to the log, most expensive first
+void profile_print();
+
+#endif // STRIPPER_QMM_STATS_H
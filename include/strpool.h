@@ -0,0 +1,66 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+#ifndef STRIPPER_QMM_STRPOOL_H
+#define STRIPPER_QMM_STRPOOL_H
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <string_view>
+#include <memory>
+
+// id of a string stored in a StringPool
+typedef uint32_t StrId;
+
+// ids that are the same in every pool
+const StrId str_empty = 0;          // ""
+const StrId str_classname = 1;      // "classname"
+// returned by StringPool::find() if a string is not in the pool
+const StrId str_none = (StrId)-1;
+
+// stores every distinct string once and hands out compact ids for them. strings are never removed
+// and their storage never moves, so ids and views stay valid for the lifetime of the pool. the whole
+// pool is freed at once when it is destroyed
+struct StringPool {
+    public:
+        StringPool();
+        StringPool(const StringPool&) = delete;
+        StringPool& operator=(const StringPool&) = delete;
+
+        // return the id for str, adding it to the pool if needed
+        StrId intern(std::string_view str);
+        // return the id for str, or str_none if it is not in the pool
+        StrId find(std::string_view str) const;
+
+        // return the string for an id
+        std::string_view get(StrId id) const { return this->strings[id]; }
+        // return the string for an id (strings are always null-terminated)
+        const char* c_str(StrId id) const { return this->strings[id].data(); }
+
+        // return the number of strings in the pool
+        size_t size() const { return this->strings.size(); }
+
+        // return the table of strings by id. string storage never moves, so a copy of this can be read on
+        // another thread while more strings are added to the pool (as long as the pool is kept alive)
+        const std::vector<std::string_view>& get_strings() const { return this->strings; }
+
+    private:
+        // string data is packed into large blocks
+        std::vector<std::unique_ptr<char[]>> blocks;
+        size_t block_used = 0;
+        size_t block_size = 0;
+
+        std::vector<std::string_view> strings;
+        std::unordered_map<std::string_view, StrId> ids;
+};
+
+#endif // STRIPPER_QMM_STRPOOL_H
@@ -0,0 +1,32 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+#ifndef STRIPPER_QMM_THREADS_H
+#define STRIPPER_QMM_THREADS_H
+
+#include <cstddef>
+#include <functional>
+
+// most worker threads allowed
+const int threads_max = 64;
+
+// set the number of worker threads (0 = all work is done on the calling thread). threads are started or
+// stopped as needed. must only be called from the game thread
+void threads_set_count(int count);
+// return the number of worker threads
+int threads_get_count();
+
+// split [0, count) into chunks of at least min_chunk and call func(begin, end) on each chunk, using the worker
+// threads and the calling thread. returns once every chunk is done. func must be safe to call from multiple
+// threads at once. must only be called from the game thread
+void threads_for(size_t count, size_t min_chunk, const std::function<void(size_t, size_t)>& func);
+
+#endif // STRIPPER_QMM_THREADS_H
@@ -0,0 +1,37 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+#ifndef STRIPPER_QMM_TOKENIZER_H
+#define STRIPPER_QMM_TOKENIZER_H
+
+#include <string>
+#include <string_view>
+
+// splits an entstring or config file into tokens in a single pass. tokens are views into the source
+// buffer, so the source must outlive any tokens returned. the only exception is an unquoted token that
+// contains non-printable characters (which are stripped), which is built in internal storage and is
+// only valid until the next call to next()
+struct Tokenizer {
+    public:
+        Tokenizer(std::string_view src);
+
+        // get the next token, returns false if there are no more tokens
+        bool next(std::string_view& token);
+
+    private:
+        std::string_view src;
+        size_t pos = 0;
+
+        // storage for unquoted tokens that had non-printable characters stripped
+        std::string scratch;
+};
+
+#endif // STRIPPER_QMM_TOKENIZER_H
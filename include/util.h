@@ -12,12 +12,17 @@ Created By:
 #ifndef STRIPPER_QMM_UTIL_H
 #define STRIPPER_QMM_UTIL_H
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 std::string str_tolower(std::string str);
 int str_stristr(std::string haystack, std::string needle);
 int str_stricmp(std::string s1, std::string s2);
-int str_striequal(std::string s1, std::string s2);
+int str_striequal(std::string_view s1, std::string_view s2);
+
+// 64-bit FNV-1a hash of data, optionally continuing from a previous hash
+uint64_t hash_fnv1a(std::string_view data, uint64_t hash = 14695981039346656037ULL);
 
 // "safe" strncpy that always null-terminates
 char* strncpyz(char* dest, const char* src, std::size_t count); 
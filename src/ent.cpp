@@ -16,19 +16,145 @@ Created By:
 #include <ctype.h>
 
 #include <vector>
-#include <map>
+#include <unordered_map>
 #include <string>
-#include <regex>
+#include <string_view>
+#include <memory>
+#include <algorithm>
+#include <tuple>
+#include <iterator>
 
 #include "game.h"
 #include "ent.h"
+#include "rules.h"
+#include "stats.h"
+#include "strpool.h"
+#include "threads.h"
+#include "tokenizer.h"
 #include "util.h"
 
 
-MapEntities::MapEntities() : tokeniter(tokenlist.begin()) { }
+// smallest number of entities given to each worker thread when matching
+static const size_t s_match_chunk = 256;
 
+// largest single G_FS_WRITE when writing dumps
+static const size_t s_write_chunk = 1024 * 1024;
 
-MapEntities::MapEntities(const MapEntities& other) {
+
+// append entities to buf in entstring format, or in dump format if indent is set (keyvals start with a tab). get
+// returns the string for an id. the total size is worked out first, so buf is only grown once
+template <typename GetStr>
+static void s_serialize(const EntList& entlist, GetStr get, bool indent, std::string& buf) {
+	// "{\n" + "}\n", and "\"" + key + "\" \"" + val + "\"\n" for each keyval
+	const size_t keyval_chars = indent ? 7 : 6;
+	size_t size = 0;
+	for (auto& entref : entlist) {
+		const Ent& ent = *entref;
+		size += 4;
+		for (size_t i = 0; i < ent.size(); i++)
+			size += keyval_chars + get(ent.keys[i]).size() + get(ent.vals[i]).size();
+	}
+
+	size_t start = buf.size();
+	buf.resize(start + size);
+	char* out = buf.data() + start;
+	auto put = [&out](std::string_view str) {
+		memcpy(out, str.data(), str.size());
+		out += str.size();
+	};
+
+	for (auto& entref : entlist) {
+		const Ent& ent = *entref;
+		put("{\n");
+		for (size_t i = 0; i < ent.size(); i++) {
+			if (indent)
+				*out++ = '\t';
+			*out++ = '"';
+			put(get(ent.keys[i]));
+			put("\" \"");
+			put(get(ent.vals[i]));
+			put("\"\n");
+		}
+		put("}\n");
+	}
+}
+
+
+// return the val for key, or nullptr if key doesn't exist
+const StrId* Ent::get(StrId key) const {
+	if (!(this->keysig & key_bit(key)))
+		return nullptr;
+
+	for (size_t i = 0; i < this->keys.size(); i++) {
+		if (this->keys[i] == key)
+			return &this->vals[i];
+	}
+	return nullptr;
+}
+
+
+// set the val for key, adding key in sorted position if it doesn't exist
+void Ent::set(const StringPool& pool, StrId key, StrId val) {
+	if (key == str_classname)
+		this->classname = val;
+
+	// key exists, just replace val
+	if (this->keysig & key_bit(key)) {
+		for (size_t i = 0; i < this->keys.size(); i++) {
+			if (this->keys[i] == key) {
+				this->vals[i] = val;
+				return;
+			}
+		}
+	}
+
+	// keys are kept in string order, not id order
+	std::string_view keystr = pool.get(key);
+	auto iter = std::lower_bound(this->keys.begin(), this->keys.end(), keystr, [&pool](StrId a, std::string_view b) {
+		return pool.get(a) < b;
+	});
+	size_t i = iter - this->keys.begin();
+
+	this->keys.insert(iter, key);
+	this->vals.insert(this->vals.begin() + i, val);
+	this->keysig |= key_bit(key);
+}
+
+
+// remove key, returns true if it existed
+bool Ent::erase(StrId key) {
+	if (!(this->keysig & key_bit(key)))
+		return false;
+
+	for (size_t i = 0; i < this->keys.size(); i++) {
+		if (this->keys[i] != key)
+			continue;
+
+		this->keys.erase(this->keys.begin() + i);
+		this->vals.erase(this->vals.begin() + i);
+		if (key == str_classname)
+			this->classname = str_empty;
+
+		// other keys may share this key's bit, so rebuild keysig
+		this->keysig = 0;
+		for (auto k : this->keys)
+			this->keysig |= key_bit(k);
+		return true;
+	}
+	return false;
+}
+
+
+MapEntities::MapEntities() : MapEntities(nullptr) { }
+
+
+MapEntities::MapEntities(std::shared_ptr<StringPool> pool) : pool(pool) {
+	if (!this->pool)
+		this->pool = std::make_shared<StringPool>();
+}
+
+
+MapEntities::MapEntities(const MapEntities& other) : MapEntities(other.pool) {
 	if (&other == this)
 		return;
 
@@ -41,13 +167,16 @@ MapEntities& MapEntities::operator=(const MapEntities& other) {
 		return *this;
 
 	// grab other's data
+	this->pool = other.pool;
+	// entities are shared until one of the lists changes them. entstring is left to be regenerated if needed
 	this->entlist = other.entlist;
-	this->tokenlist = other.tokenlist;
-	this->entstring = other.entstring;
+	this->entstring = {};
+	this->source_hash = other.source_hash;
+	this->entstring_dirty = true;
+	this->indexes = other.indexes;
 
-	// calculate other's tokeniter offset to set ours to point to the same entity
-	auto other_offset = other.tokeniter - other.tokenlist.begin();
-	this->tokeniter = this->tokenlist.begin() + other_offset;
+	// cursor only holds positions, so it points to the same token in our copy
+	this->tokencursor = other.tokencursor;
 
 	return *this;
 }
@@ -66,568 +195,1116 @@ MapEntities& MapEntities::operator=(MapEntities&& other) noexcept {
 		return *this;
 
 	// swap data
+	std::swap(this->pool, other.pool);
 	std::swap(this->entlist, other.entlist);
-	std::swap(this->tokenlist, other.tokenlist);
 	std::swap(this->entstring, other.entstring);
-	std::swap(this->tokeniter, other.tokeniter);
+	std::swap(this->source_hash, other.source_hash);
+	std::swap(this->tokencursor, other.tokencursor);
+	std::swap(this->entstring_dirty, other.entstring_dirty);
+	std::swap(this->indexes, other.indexes);
 
 	return *this;
 }
 
 
 // populate MapEntities from entstring
-void MapEntities::make_from_entstring(EntString entstring) {
-	TokenList tokenlist = tokenlist_from_entstring(entstring);
+void MapEntities::make_from_entstring(std::string_view entstring) {
+	// entlist should be the definitive source that the other fields are generated from
+	this->entlist = entlist_from_entstring(*this->pool, entstring);
+	this->source_hash = hash_fnv1a(entstring);
+	this->indexes.clear();
+	this->mark_dirty();
+}
+
 
+// populate MapEntities from engine tokens
+void MapEntities::make_from_engine() {
 	// entlist should be the definitive source that the other fields are generated from
-	this->entlist = entlist_from_tokenlist(tokenlist);
+	this->entlist = entlist_from_engine(*this->pool, this->source_hash);
+	this->indexes.clear();
+	this->mark_dirty();
+}
 
-	this->tokenlist = tokenlist_from_entlist(this->entlist);
-	this->tokeniter = this->tokenlist.begin();
 
-	this->entstring = entstring_from_entlist(this->entlist);
+// load and parse config file
+void MapEntities::apply_config(std::string file) {
+	// get compiled config, only re-parsing the file if it changed since it was last loaded
+	std::shared_ptr<const RuleProgram> program = RuleProgram::load(file);
+	if (!program)
+		return;
+
+	this->apply_config(*program, file);
 }
 
 
-// populate MapEntities from engine tokens
-void MapEntities::make_from_engine() {
-	TokenList tokenlist = tokenlist_from_engine();
+// apply an already loaded config to ents
+void MapEntities::apply_config(const RuleProgram& program, std::string file) {
+	// count how many actual map ents are affected
+	int num_filtered = 0, num_added = 0, num_replaced = 0;
 
-	// entlist should be the definitive source that the other fields are generated from
-	this->entlist = entlist_from_tokenlist(tokenlist);
+	this->apply_rules(program, file, 0, program.rules.size(), num_filtered, num_added, num_replaced);
 
-	this->tokenlist = tokenlist_from_entlist(this->entlist);
-	this->tokeniter = this->tokenlist.begin();
+	QMM_WRITEQMMLOG(QMMLOG_INFO, "Loaded %d filters, %d adds, %d replace, and %d withs from %s.\n", program.num_filters, program.num_adds, program.num_replaces, program.num_withs, file.c_str());
+	QMM_WRITEQMMLOG(QMMLOG_INFO, "Removed %d entities, added %d entities, and replaced %d entities.\n", num_filtered, num_added, num_replaced);
+}
+
+
+// add keyval to all entities
+void MapEntities::add_keyval(std::string key, std::string val) {
+	StrId keyid = this->pool->intern(key);
+	StrId valid = this->pool->intern(val);
+	for (size_t pos = 0; pos < this->entlist.size(); pos++)
+		this->edit_ent(pos).set(*this->pool, keyid, valid);
+
+	// simpler to rebuild any indexes than to update every entity's position
+	this->indexes.clear();
 
-	this->entstring = entstring_from_entlist(this->entlist);
+	this->mark_dirty();
 }
 
 
-// load and parse config file
-void MapEntities::apply_config(std::string file) {
+// return the next token. tokens are read straight from entlist: "{", each key and val, then "}" for every entity
+intptr_t MapEntities::get_next_token(char* buf, intptr_t len) {
+	TokenCursor& cursor = this->tokencursor;
+
+	if (cursor.ent >= this->entlist.size())
+		return 0;
+
+	const Ent& ent = *this->entlist[cursor.ent];
+	std::string_view token;
+
+	switch (cursor.phase) {
+		case TokenCursor::phase_open:
+			token = "{";
+			cursor.keyval = 0;
+			cursor.phase = ent.empty() ? TokenCursor::phase_close : TokenCursor::phase_key;
+			break;
+		case TokenCursor::phase_key:
+			token = this->pool->get(ent.keys[cursor.keyval]);
+			cursor.phase = TokenCursor::phase_val;
+			break;
+		case TokenCursor::phase_val:
+			token = this->pool->get(ent.vals[cursor.keyval]);
+			cursor.keyval++;
+			cursor.phase = cursor.keyval < ent.size() ? TokenCursor::phase_key : TokenCursor::phase_close;
+			break;
+		case TokenCursor::phase_close:
+			token = "}";
+			cursor.ent++;
+			cursor.phase = TokenCursor::phase_open;
+			break;
+	}
+
+	// copy as much of the token as will fit, always null-terminated
+	if (len > 0) {
+		size_t size = std::min(token.size(), (size_t)len - 1);
+		memcpy(buf, token.data(), size);
+		buf[size] = '\0';
+	}
+
+	return 1;
+}
+
+
+// return entlist
+const EntList& MapEntities::get_entlist() {
+	return this->entlist;
+}
+
+
+// return entstring
+const EntString& MapEntities::get_entstring() {
+	if (this->entstring_dirty) {
+		this->entstring = entstring_from_entlist(*this->pool, this->entlist);
+		this->entstring_dirty = false;
+	}
+	return this->entstring;
+}
+
+
+// return string pool that entlist's ids refer to
+const StringPool& MapEntities::get_pool() {
+	return *this->pool;
+}
+
+
+// return hash of the entstring or engine tokens this list was made from
+uint64_t MapEntities::get_source_hash() const {
+	return this->source_hash;
+}
+
+
+// dump to file
+void MapEntities::dump_to_file(std::string file, bool append) {
+	std::string buf;
+	this->dump_to_buffer(buf);
+	MapEntities::write_dump(file, buf, append);
+}
+
+
+// append entlist to buf in the same format as dump_to_file
+void MapEntities::dump_to_buffer(std::string& buf) const {
+	s_serialize(this->entlist, [this](StrId id) { return this->pool->get(id); }, true, buf);
+}
+
+
+// return a copy of entlist for dump_snapshot()
+EntSnapshot MapEntities::get_snapshot() const {
+	return { this->pool, this->pool->get_strings(), this->entlist };
+}
+
+
+// append a snapshot to buf in the same format as dump_to_file
+void MapEntities::dump_snapshot(const EntSnapshot& snapshot, std::string& buf) {
+	s_serialize(snapshot.entlist, [&snapshot](StrId id) { return snapshot.strings[id]; }, true, buf);
+}
+
+
+// hash of an entity's keyvals. keys are kept in string order and strings are interned, so entities with the same
+// keyvals (from the same pool) have the same keys and vals arrays
+static uint64_t s_content_hash(const Ent& ent) {
+	// fnv-1a over whole key/val id pairs instead of bytes, since this runs on every entity of a map
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < ent.size(); i++)
+		hash = (hash ^ (((uint64_t)ent.keys[i] << 32) | ent.vals[i])) * 1099511628211ULL;
+	return hash;
+}
+
+
+// keys used to pair up an entity with its changed version, in order of preference
+static const char* s_identity_keys[] = { "origin", "targetname", "model", "classname" };
+
+
+// hash of an entity's val for key (a pool id). returns false if the entity doesn't have key
+static bool s_identity_hash(StrId key, const Ent& ent, uint64_t& hash) {
+	const StrId* val = key == str_none ? nullptr : ent.get(key);
+	if (!val)
+		return false;
+	hash = hash_fnv1a(std::string_view((const char*)val, sizeof(*val)));
+	return true;
+}
+
+
+// returns true if a val can be used as-is in a filter/replace mask (empty vals and /regex/ vals mean something else)
+static bool s_maskable(std::string_view val) {
+	return !val.empty() && !(val.size() >= 2 && val.front() == '/' && val.back() == '/');
+}
+
+
+// append an entity block in config format. if mask is set, keyvals that can't be matched exactly are left out
+static void s_delta_block(const StringPool& pool, const Ent& ent, bool mask, std::string& buf) {
+	buf += "{\n";
+	for (size_t i = 0; i < ent.size(); i++) {
+		std::string_view val = pool.get(ent.vals[i]);
+		if (mask && !s_maskable(val))
+			continue;
+		buf += "\t\"";
+		buf += pool.get(ent.keys[i]);
+		buf += "\" \"";
+		buf += val;
+		buf += "\"\n";
+	}
+	buf += "}\n";
+}
+
+
+// returns true if ent has keyvals that can go in a mask. an empty mask would match every entity
+static bool s_has_mask(const StringPool& pool, const Ent& ent) {
+	for (size_t i = 0; i < ent.size(); i++) {
+		if (s_maskable(pool.get(ent.vals[i])))
+			return true;
+	}
+	return false;
+}
+
+
+// returns true if ent has every keyval of mask that s_delta_block() would put in a mask
+static bool s_mask_matches(const StringPool& pool, const Ent& mask, const Ent& ent) {
+	for (size_t i = 0; i < mask.size(); i++) {
+		if (!s_maskable(pool.get(mask.vals[i])))
+			continue;
+		const StrId* val = ent.get(mask.keys[i]);
+		if (!val || *val != mask.vals[i])
+			return false;
+	}
+	return true;
+}
+
+
+// log that part of a delta won't give the same result when the delta is applied
+static void s_delta_warn(const StringPool& pool, const Ent& ent, size_t pos, const char* problem) {
+	std::string_view classname = pool.get(ent.classname);
+	QMM_WRITEQMMLOG(QMMLOG_WARNING, "stripper_dump delta: Entity %d (\"%.*s\") %s\n", (int)pos, (int)classname.size(), classname.data(), problem);
+}
+
+
+// append a "with" block that turns from into to: new or changed keys get their new val, removed keys get ""
+static void s_delta_with(const StringPool& pool, const Ent& from, const Ent& to, std::string& buf) {
+	auto put = [&](StrId key, std::string_view val) {
+		buf += "\t\"";
+		buf += pool.get(key);
+		buf += "\" \"";
+		buf += val;
+		buf += "\"\n";
+	};
+
+	buf += "{\n";
+	// both key lists are in string order, so walk them together
+	size_t i = 0, j = 0;
+	while (i < from.size() || j < to.size()) {
+		int cmp;
+		if (i == from.size())
+			cmp = 1;
+		else if (j == to.size())
+			cmp = -1;
+		else if (from.keys[i] == to.keys[j])
+			cmp = 0;
+		else
+			cmp = pool.get(from.keys[i]) < pool.get(to.keys[j]) ? -1 : 1;
+
+		if (cmp < 0) {
+			put(from.keys[i], "");
+			i++;
+		}
+		else if (cmp > 0) {
+			put(to.keys[j], pool.get(to.vals[j]));
+			j++;
+		}
+		else {
+			if (from.vals[i] != to.vals[j])
+				put(to.keys[j], pool.get(to.vals[j]));
+			i++;
+			j++;
+		}
+	}
+	buf += "}\n";
+}
+
+
+// append a config to buf that turns this entity list into modents
+void MapEntities::dump_delta(const MapEntities& modents, std::string& buf) const {
+	const EntList& from = this->entlist;
+	const EntList& to = modents.entlist;
+	const StringPool& pool = *this->pool;
+	const size_t none = (size_t)-1;
+
+	// entities that are unchanged: every entity in "to" takes the first unused entity in "from" with the same keyvals
+	std::unordered_map<uint64_t, std::vector<size_t>> by_content;
+	for (size_t pos = from.size(); pos-- > 0; )
+		by_content[s_content_hash(*from[pos])].push_back(pos);
+
+	std::vector<uint8_t> from_used(from.size(), false);
+	// position in "from" of each entity in "to", or none if it was added
+	std::vector<size_t> to_from(to.size(), none);
+	std::vector<size_t> added;
+	for (size_t pos = 0; pos < to.size(); pos++) {
+		bool found = false;
+		auto iter = by_content.find(s_content_hash(*to[pos]));
+		if (iter != by_content.end()) {
+			// positions are stored last first, so the back is the first unused one
+			std::vector<size_t>& list = iter->second;
+			for (size_t k = list.size(); k-- > 0; ) {
+				size_t frompos = list[k];
+				// entities that were never changed are still shared between the lists
+				if (from[frompos] == to[pos] || (from[frompos]->keys == to[pos]->keys && from[frompos]->vals == to[pos]->vals)) {
+					from_used[frompos] = true;
+					to_from[pos] = frompos;
+					list.erase(list.begin() + k);
+					found = true;
+					break;
+				}
+			}
+		}
+		if (!found)
+			added.push_back(pos);
+	}
+
+	// pair the rest up by the identity keys, one key at a time and in order. a pair is a changed entity, and anything
+	// left over was removed or added. an entity without any maskable keyvals can't be replaced, so it isn't paired
+	std::vector<uint8_t> to_used(to.size(), false);
+	std::vector<std::pair<size_t, size_t>> changed;
+	for (const char* identity : s_identity_keys) {
+		StrId key = pool.find(identity);
+		std::unordered_map<uint64_t, std::vector<size_t>> by_identity;
+		uint64_t hash;
+		for (size_t pos = from.size(); pos-- > 0; ) {
+			if (!from_used[pos] && s_has_mask(pool, *from[pos]) && s_identity_hash(key, *from[pos], hash))
+				by_identity[hash].push_back(pos);
+		}
+		if (by_identity.empty())
+			continue;
+
+		for (size_t pos : added) {
+			if (to_used[pos] || !s_identity_hash(key, *to[pos], hash))
+				continue;
+			auto iter = by_identity.find(hash);
+			if (iter == by_identity.end() || iter->second.empty())
+				continue;
+			size_t frompos = iter->second.back();
+			iter->second.pop_back();
+			from_used[frompos] = true;
+			to_used[pos] = true;
+			to_from[pos] = frompos;
+			changed.emplace_back(frompos, pos);
+		}
+	}
+	std::sort(changed.begin(), changed.end());
+
+	// the masks written below are only the maskable keyvals of an entity, so they can also match other entities that
+	// are kept or changed (duplicates, or entities with more keyvals). index those entities by keyval to check
+	std::unordered_map<uint64_t, std::vector<size_t>> by_keyval;
+	for (size_t pos = 0; pos < from.size(); pos++) {
+		if (!from_used[pos])
+			continue;
+		for (size_t i = 0; i < from[pos]->size(); i++)
+			by_keyval[((uint64_t)from[pos]->keys[i] << 32) | from[pos]->vals[i]].push_back(pos);
+	}
+	auto overmatches = [&](size_t frompos) {
+		const Ent& mask = *from[frompos];
+		const std::vector<size_t>* smallest = nullptr;
+		for (size_t i = 0; i < mask.size(); i++) {
+			if (!s_maskable(pool.get(mask.vals[i])))
+				continue;
+			auto iter = by_keyval.find(((uint64_t)mask.keys[i] << 32) | mask.vals[i]);
+			if (iter == by_keyval.end())
+				return false;
+			if (!smallest || iter->second.size() < smallest->size())
+				smallest = &iter->second;
+		}
+		for (size_t pos : *smallest) {
+			if (pos != frompos && s_mask_matches(pool, mask, *from[pos]))
+				return true;
+		}
+		return false;
+	};
+
+	// removed entities are filtered first so their masks can't match added entities
+	bool header = false;
+	for (size_t pos = 0; pos < from.size(); pos++) {
+		if (from_used[pos])
+			continue;
+		if (!s_has_mask(pool, *from[pos])) {
+			s_delta_warn(pool, *from[pos], pos, "was removed, but has no keyvals that can be used in a filter mask");
+			continue;
+		}
+		if (overmatches(pos))
+			s_delta_warn(pool, *from[pos], pos, "was removed, but its filter mask also matches other entities that were kept");
+		if (!header) {
+			buf += "filter:\n";
+			header = true;
+		}
+		s_delta_block(pool, *from[pos], true, buf);
+	}
+
+	for (auto& pair : changed) {
+		if (overmatches(pair.first))
+			s_delta_warn(pool, *from[pair.first], pair.first, "was changed, but its replace mask also matches other entities");
+		buf += "replace:\n";
+		s_delta_block(pool, *from[pair.first], true, buf);
+		buf += "with:\n";
+		s_delta_with(pool, *from[pair.first], *to[pair.second], buf);
+	}
+
+	header = false;
+	for (size_t pos : added) {
+		if (to_used[pos])
+			continue;
+		if (!header) {
+			buf += "add:\n";
+			header = true;
+		}
+		s_delta_block(pool, *to[pos], false, buf);
+	}
+
+	// a config never moves entities, and only adds them at the end (or worldspawn at the beginning)
+	bool reordered = false;
+	size_t last = none;
+	for (size_t pos = 0; pos < to.size() && !reordered; pos++) {
+		if (to_from[pos] != none) {
+			reordered = last != none && to_from[pos] < last;
+			last = to_from[pos];
+		}
+		else if (pool.get(to[pos]->classname) == "worldspawn")
+			reordered = last != none;
+		else
+			last = from.size();
+	}
+	if (reordered)
+		QMM_WRITEQMMLOG(QMMLOG_WARNING, "stripper_dump delta: Entities are in a different order, which the delta doesn't reproduce\n");
+}
+
+
+// write a buffer made by dump_snapshot() to file, in a few large writes
+void MapEntities::write_dump(std::string file, std::string_view buf, bool append) {
+	fileHandle_t f = 0;
+	int ret = g_syscall(G_FS_FOPEN_FILE, file.c_str(), &f, append ? FS_APPEND : FS_WRITE);
+	if (ret < 0 || !f) {
+		QMM_WRITEQMMLOG(QMMLOG_INFO, "Unable to write ent dump to %s\n", file.c_str());
+		return;
+	}
+	for (size_t pos = 0; pos < buf.size(); pos += s_write_chunk) {
+		size_t len = std::min(s_write_chunk, buf.size() - pos);
+		g_syscall(G_FS_WRITE, buf.data() + pos, (int)len, f);
+	}
+	g_syscall(G_FS_FCLOSE_FILE, f);
+	QMM_WRITEQMMLOG(QMMLOG_INFO, "Ent dump written to %s\n", file.c_str());
+}
+
+
+// populate MapEntities from a cache file. the file is the key in hex on the first line, followed by an entstring
+bool MapEntities::load_cache(std::string file, uint64_t key) {
 	fileHandle_t f = 0;
 	intptr_t size = g_syscall(G_FS_FOPEN_FILE, file.c_str(), &f, FS_READ);
-	// file failed to load
+	// no cache file
 	if (size <= 0 || !f) {
 		if (f)
 			g_syscall(G_FS_FCLOSE_FILE, f);
-		QMM_WRITEQMMLOG(QMMLOG_WARNING, "Failed to open file \"%s\" for reading.\n", file.c_str());
-		return;
+		return false;
 	}
 
-	// read entire file
-	std::vector<char> buf;
-	buf.resize(size + 1);
+	std::string buf;
+	buf.resize(size);
 	g_syscall(G_FS_READ, buf.data(), size, f);
 	g_syscall(G_FS_FCLOSE_FILE, f);
-	buf[size] = '\0';
 
-	// check for '=' to warn that it likely won't load
-	if (strchr(buf.data(), '='))
-		QMM_WRITEQMMLOG(QMMLOG_WARNING, "Possible old config format detected in \"%s\", likely will fail to load.\n", file.c_str());
+	// cache file is for different entities or configs
+	std::string header = QMM_VARARGS("%016llx\n", (unsigned long long)key);
+	if (buf.compare(0, header.size(), header) != 0)
+		return false;
 
-	// tokenize it
-	TokenList tokens = tokenlist_from_entstring(buf.data());
-	buf.clear();
+	std::string_view entstring(buf);
+	entstring.remove_prefix(header.size());
+	this->make_from_entstring(entstring);
 
-	// the current ent we are building
-	Ent ent;
-	// store key. when a val is received, make a new entry into ent
-	std::string key;
+	// save_cache only writes files that parse back into the same entities, so entstring is exactly what
+	// would be generated from entlist anyway
+	this->entstring = entstring;
+	this->entstring_dirty = false;
 
-	// this stores all info for entities that should be replaced
-	// nodes are read and removed from this list when a "with" entity is found
-	EntList replace_entlist;
+	return true;
+}
 
-	// count how many entities are loaded
-	int num_filters = 0, num_adds = 0, num_replaces = 0, num_withs = 0;
 
-	// count how many actual map ents are affected
-	int num_filtered = 0, num_added = 0, num_replaced = 0;
+// replace each entity with other's copy of an identical entity, so they are shared again
+void MapEntities::share_ents(const MapEntities& other) {
+	if (this->pool != other.pool)
+		return;
 
-	// what the current entity mode is
-	enum Mode {
-		mode_filter,
-		mode_add,
-		mode_replace,
-		mode_with,
-	} mode = mode_filter;
-
-	bool inside_ent = false;	// false = between ents, true = inside an ent
-	bool is_key = true;			// true = expecting key, false = expecting val 
-
-	// go through every token
-	for (const auto& token : tokens) {
-		// if not inside an entity, we can either start a new entity or switch modes
-		if (!inside_ent) {
-			// look for mode tokens
-			if (str_striequal(token, "filter:")) {
-				mode = mode_filter;
-			}
-			else if (str_striequal(token, "add:")) {
-				mode = mode_add;
-			}
-			else if (str_striequal(token, "replace:")) {
-				mode = mode_replace;
-			}
-			else if (str_striequal(token, "with:")) {
-				mode = mode_with;
-			}
+	auto same = [](const Ent& a, const Ent& b) { return a.keys == b.keys && a.vals == b.vals; };
 
-			// valid opening brace, make a new entity
-			else if (token == "{") {
-				inside_ent = true;
-				is_key = true;
-				ent = {};
-			}
+	// (content hash, position) of other's entities, sorted to be searched. only built if the lists differ
+	std::vector<std::pair<uint64_t, size_t>> by_content;
 
-			// unknown token
-			else {
-				QMM_WRITEQMMLOG(QMMLOG_WARNING, "Unexpected token \"%s\", expected \"filter:\", \"add:\", \"replace:\", \"with:\", or \"{\"; ignoring.\n", token.c_str());
+	// the keyvals are the same, so entstring and indexes don't change
+	size_t next = 0;
+	for (auto& ent : this->entlist) {
+		// entities that weren't changed are usually in the same order in both lists, with a few removed in between
+		size_t ahead = next;
+		while (ahead < other.entlist.size() && ahead < next + 4 && !same(*other.entlist[ahead], *ent))
+			ahead++;
+		if (ahead < other.entlist.size() && ahead < next + 4) {
+			ent = other.entlist[ahead];
+			next = ahead + 1;
+			continue;
+		}
+
+		if (by_content.empty()) {
+			by_content.reserve(other.entlist.size());
+			for (size_t pos = 0; pos < other.entlist.size(); pos++)
+				by_content.emplace_back(s_content_hash(*other.entlist[pos]), pos);
+			std::sort(by_content.begin(), by_content.end());
+		}
+		uint64_t hash = s_content_hash(*ent);
+		for (auto iter = std::lower_bound(by_content.begin(), by_content.end(), std::make_pair(hash, (size_t)0)); iter != by_content.end() && iter->first == hash; ++iter) {
+			if (same(*other.entlist[iter->second], *ent)) {
+				ent = other.entlist[iter->second];
+				next = iter->second + 1;
+				break;
 			}
 		}
-		// inside an entity. we can either have a key, value, or end the entity
-		else {
-			// if this is a valid closing brace, handle the entity filter
-			if (token == "}") {
-				inside_ent = false;
+	}
+}
 
-				// if entity ended between key and val, print warning
-				if (!is_key) {
-					QMM_WRITEQMMLOG(QMMLOG_WARNING, "Unexpected end of entity with hanging key \"%s\"; ignoring.\n", key.c_str());
-				}
 
-				// filter mode, don't accept empty entity
-				if (mode == mode_filter) {
-					if (ent.keyvals.empty()) {
-						QMM_WRITEQMMLOG(QMMLOG_WARNING, "Empty \"filter\" entity found; ignoring.\n");
-					}
-					else {
-						num_filters++;
-						num_filtered += this->filter_ents(ent);
-					}
-				}
-				// add mode, don't accept empty entity or one without a classname
-				else if (mode == mode_add) {
-					if (ent.keyvals.empty()) {
-						QMM_WRITEQMMLOG(QMMLOG_WARNING, "Empty \"add\" entity found; ignoring.\n");
-					}
-					else if (ent.classname.empty()) {
-						QMM_WRITEQMMLOG(QMMLOG_WARNING, "Found \"add\" entity without \"classname\"; ignoring.\n");
-					}
-					else {
-						num_adds++;
-						num_added += this->add_ent(ent);
-					}
-				}
-				// replace mode, accept empty entity to match all
-				else if (mode == mode_replace) {
-					num_replaces++;
-					replace_entlist.push_back(ent);	// store until a "with" ent comes along
+// save entlist to a cache file, along with a key that identifies the inputs used to generate it
+void MapEntities::save_cache(std::string file, uint64_t key) {
+	const EntString& entstring = this->get_entstring();
+
+	// make sure entstring parses back into the same entities. this can fail if a key or val contains
+	// characters that can't be stored in an entstring (like quotes) and would give a bad cache hit later
+	EntList check = entlist_from_entstring(*this->pool, entstring);
+	bool same = check.size() == this->entlist.size();
+	for (size_t i = 0; same && i < check.size(); i++)
+		same = check[i]->keys == this->entlist[i]->keys && check[i]->vals == this->entlist[i]->vals;
+	if (!same) {
+		QMM_WRITEQMMLOG(QMMLOG_DEBUG, "Entity list can't be stored in an entstring, not writing cache to %s\n", file.c_str());
+		return;
+	}
+
+	fileHandle_t f = 0;
+	int ret = g_syscall(G_FS_FOPEN_FILE, file.c_str(), &f, FS_WRITE);
+	if (ret < 0 || !f) {
+		QMM_WRITEQMMLOG(QMMLOG_INFO, "Unable to write cache to %s\n", file.c_str());
+		return;
+	}
+	std::string header = QMM_VARARGS("%016llx\n", (unsigned long long)key);
+	g_syscall(G_FS_WRITE, header.c_str(), header.size(), f);
+	g_syscall(G_FS_WRITE, entstring.c_str(), entstring.size(), f);
+	g_syscall(G_FS_FCLOSE_FILE, f);
+	QMM_WRITEQMMLOG(QMMLOG_DEBUG, "Cache written to %s\n", file.c_str());
+}
+
+
+// run rules [begin, end) from a compiled config against the entities
+void MapEntities::apply_rules(const RuleProgram& program, const std::string& file, size_t begin, size_t end, int& num_filtered, int& num_added, int& num_replaced) {
+	std::vector<BoundMatcher> bound_list;
+	bool profiling = profile_enabled();
+
+	// no structural edits yet
+	this->removed.assign(this->entlist.size(), false);
+	this->num_removed = 0;
+	this->prepends.clear();
+
+	end = std::min(end, program.rules.size());
+	for (size_t i = begin; i < end; i++) {
+		const Rule& rule = program.rules[i];
+		switch (rule.type) {
+			case Rule::rule_filter:
+				bound_list.clear();
+				for (auto& filter : rule.filter) {
+					bound_list.push_back(filter.bind(*this->pool));
+					if (profiling)
+						bound_list.back().profile = profile_block(file, filter.line, "filter");
 				}
-				// with mode, don't accept empty entity
-				else if (mode == mode_with) {
-					if (ent.keyvals.empty()) {
-						QMM_WRITEQMMLOG(QMMLOG_WARNING, "Empty \"with\" entity found; ignoring.\n");
-					}
-					else {
-						num_withs++;
-						num_replaced += this->replace_ents(replace_entlist, ent);
-						// "with" entry uses up all prior "replace" entities
-						replace_entlist.clear();
-					}
+				num_filtered += this->filter_ents(bound_list);
+				break;
+			case Rule::rule_add: {
+				StatTimer timer;
+				int added = this->add_ent(rule.ent);
+				num_added += added;
+				if (profiling) {
+					BlockProfile* profile = profile_block(file, rule.line, "add");
+					profile->matched += added;
+					profile->ms += timer.ms();
 				}
+				break;
 			}
-
-			// look for mode tokens or opening brace
-			else if (
-				str_striequal(token, "filter:")
-				|| str_striequal(token, "add:")
-				|| str_striequal(token, "replace:")
-				|| str_striequal(token, "with:")
-				|| token == "{"
-				) {
-				QMM_WRITEQMMLOG(QMMLOG_WARNING, "Unexpected \"%s\" token found inside an entity; ignoring.\n", token.c_str());
-			}
-
-			// it's a key or val
-			else {
-				// this is a key
-				if (is_key) {
-					// if key is empty, skip it
-					if (token.empty()) {
-						QMM_WRITEQMMLOG(QMMLOG_WARNING, "Unexpected empty token found, expected key; ignoring.\n");
-					}
-					else {
-						is_key = false;
-						key = token;
-					}
+			case Rule::rule_replace: {
+				StatTimer timer;
+				bound_list.clear();
+				for (auto& replace : rule.replace) {
+					bound_list.push_back(replace.bind(*this->pool));
+					if (profiling)
+						bound_list.back().profile = profile_block(file, replace.line, "replace");
 				}
-				// this is a value
-				else {
-					is_key = true;
-
-					// don't allow value to be empty in "add:" block
-					if (mode == mode_add && token.empty()) {
-						QMM_WRITEQMMLOG(QMMLOG_WARNING, "Unexpected empty value for key \"%s\" found in \"add\" entity; ignoring.\n", key.c_str());
-					}
-					else {
-						// store keyval in ent
-						ent.keyvals[key] = token;
-						// store classname for easier lookup
-						if (key == "classname") {
-							ent.classname = token;
-						}
-					}
+				int replaced = this->replace_ents(bound_list, rule.ent);
+				num_replaced += replaced;
+				if (profiling) {
+					BlockProfile* profile = profile_block(file, rule.line, "with");
+					profile->matched += replaced;
+					profile->ms += timer.ms();
 				}
+				break;
 			}
 		}
 	}
 
-	this->tokenlist = tokenlist_from_entlist(this->entlist);
-	this->tokeniter = this->tokenlist.begin();
-	this->entstring = entstring_from_entlist(this->entlist);
+	// apply all removals and worldspawn moves at once
+	this->compact();
 
-	QMM_WRITEQMMLOG(QMMLOG_INFO, "Loaded %d filters, %d adds, %d replace, and %d withs from %s.\n", num_filters, num_adds, num_replaces, num_withs, file.c_str());
-	QMM_WRITEQMMLOG(QMMLOG_INFO, "Removed %d entities, added %d entities, and replaced %d entities.\n", num_filtered, num_added, num_replaced);
+	this->mark_dirty();
 }
 
 
-// add keyval to all entities
-void MapEntities::add_keyval(std::string key, std::string val) {
-	for (auto& ent : this->entlist)
-		ent.keyvals[key] = val;
+// MapEntities private functions
+// =============================
+
 
-	this->tokenlist = tokenlist_from_entlist(this->entlist);
-	this->tokeniter = this->tokenlist.begin();
-	this->entstring = entstring_from_entlist(this->entlist);
+// return the entity at pos for changing. an entity that is shared with another list (or a snapshot) is copied
+// first. entities are only ever shared by the game thread, so a use count of 1 can't be out of date
+Ent& MapEntities::edit_ent(size_t pos) {
+	std::shared_ptr<const Ent>& ent = this->entlist[pos];
+	if (ent.use_count() > 1)
+		ent = std::make_shared<Ent>(*ent);
+	// every Ent is created by make_shared<Ent>, so only the pointer is const and it is safe to change
+	return const_cast<Ent&>(*ent);
 }
 
 
-// return the next token
-intptr_t MapEntities::get_next_token(char* buf, intptr_t len) {
-	if (this->tokeniter == this->tokenlist.end())
-		return 0;
+// mark entstring as out of date after entlist changes (it is freed now and only regenerated when next
+// requested), and restart the token cursor at the first token
+void MapEntities::mark_dirty() {
+	this->entstring = {};
+	this->entstring_dirty = true;
+	this->tokencursor = {};
+}
 
-	strncpyz(buf, this->tokeniter->c_str(), len);
 
-	this->tokeniter++;
+// apply structural edits logged while running rules: tombstoned entities are removed, and
+// logged worldspawn entities are moved to the beginning (most recently added first)
+void MapEntities::compact() {
+	if (!this->num_removed && this->prepends.empty())
+		return;
 
-	return 1;
-}
+	const size_t gone = (size_t)-1;
+	std::vector<size_t> newpos(this->entlist.size(), gone);
+	EntList compacted;
+	compacted.reserve(this->entlist.size() - this->num_removed);
 
+	// each added worldspawn was inserted at the beginning, so the last one added is first
+	for (auto iter = this->prepends.rbegin(); iter != this->prepends.rend(); ++iter) {
+		if (this->removed[*iter])
+			continue;
+		newpos[*iter] = compacted.size();
+		compacted.push_back(std::move(this->entlist[*iter]));
+		// so it isn't moved again in the next loop
+		this->removed[*iter] = true;
+	}
 
-// return tokenlist
-const TokenList& MapEntities::get_tokenlist() {
-	return this->tokenlist;
+	for (size_t pos = 0; pos < this->entlist.size(); pos++) {
+		if (this->removed[pos])
+			continue;
+		newpos[pos] = compacted.size();
+		compacted.push_back(std::move(this->entlist[pos]));
+	}
+
+	this->entlist = std::move(compacted);
+
+	// entities that moved to the front can leave index lists unsorted, so just let them rebuild
+	if (!this->prepends.empty()) {
+		this->indexes.clear();
+	}
+	// otherwise remaining entities keep their relative order, so just remap index positions
+	else {
+		for (auto& index : this->indexes) {
+			for (auto iter = index.second.begin(); iter != index.second.end(); ) {
+				EntPosList& list = iter->second;
+				size_t n = 0;
+				for (auto pos : list) {
+					if (newpos[pos] != gone)
+						list[n++] = newpos[pos];
+				}
+				list.resize(n);
+				if (list.empty())
+					iter = index.second.erase(iter);
+				else
+					++iter;
+			}
+		}
+	}
+
+	this->removed.assign(this->entlist.size(), false);
+	this->num_removed = 0;
+	this->prepends.clear();
 }
 
 
-// return entlist
-const EntList& MapEntities::get_entlist() {
-	return this->entlist;
+// return the index for key, building it if needed
+KeyIndex& MapEntities::get_index(StrId key) {
+	auto iter = this->indexes.find(key);
+	if (iter != this->indexes.end())
+		return iter->second;
+
+	KeyIndex& index = this->indexes[key];
+	for (size_t pos = 0; pos < this->entlist.size(); pos++) {
+		const StrId* val = this->entlist[pos]->get(key);
+		if (val)
+			index[*val].push_back(pos);
+	}
+	return index;
 }
 
 
-// return entstring
-const EntString& MapEntities::get_entstring() {
-	return this->entstring;
+// find candidate positions for a matcher by intersecting the indexes of its exact-match predicates.
+// returns false if the matcher has no exact-match predicates
+bool MapEntities::find_candidates(const BoundMatcher& matcher, EntPosList& candidates) {
+	std::vector<const EntPosList*> lists;
+	static const EntPosList empty;
+
+	// matcher can't match anything
+	if (matcher.never) {
+		candidates.clear();
+		return true;
+	}
+
+	for (auto& pred : matcher.preds) {
+		if (pred.type != Predicate::pred_exact)
+			continue;
+
+		KeyIndex& index = this->get_index(pred.key);
+		auto iter = index.find(pred.val);
+		lists.push_back(iter == index.end() ? &empty : &iter->second);
+	}
+
+	if (lists.empty())
+		return false;
+
+	// start with the smallest list and intersect with the rest
+	std::sort(lists.begin(), lists.end(), [](const EntPosList* a, const EntPosList* b) {
+		return a->size() < b->size();
+	});
+
+	candidates = *lists[0];
+	EntPosList tmp;
+	for (size_t i = 1; i < lists.size() && !candidates.empty(); i++) {
+		tmp.clear();
+		std::set_intersection(candidates.begin(), candidates.end(), lists[i]->begin(), lists[i]->end(), std::back_inserter(tmp));
+		candidates.swap(tmp);
+	}
+
+	return true;
 }
 
 
-// dump to file
-void MapEntities::dump_to_file(std::string file, bool append) {
-	fileHandle_t f = 0;
-	int ret = g_syscall(G_FS_FOPEN_FILE, file.c_str(), &f, append ? FS_APPEND : FS_WRITE);
-	if (ret < 0 || !f) {
-		QMM_WRITEQMMLOG(QMMLOG_INFO, "Unable to write ent dump to %s\n", file.c_str());
+// update indexes after the val of key on the entity at pos changes (nullptr = no val)
+void MapEntities::update_index(size_t pos, StrId key, const StrId* oldval, const StrId* newval) {
+	auto iter = this->indexes.find(key);
+	if (iter == this->indexes.end())
 		return;
-	}
-	// output entities in engine entity format: {} on separate lines, tabbed indents, and "" surrounding key and val
-	for (auto& ent : this->entlist) {
-		g_syscall(G_FS_WRITE, "{\n", 2, f);
-		for (auto& keyval : ent.keyvals) {
-			std::string s = "\t\"" + keyval.first + "\" \"" + keyval.second + "\"\n";
-			g_syscall(G_FS_WRITE, s.c_str(), s.size(), f);
+	KeyIndex& index = iter->second;
+
+	// remove pos from the old val's list
+	if (oldval) {
+		auto list = index.find(*oldval);
+		if (list != index.end()) {
+			auto it = std::lower_bound(list->second.begin(), list->second.end(), pos);
+			if (it != list->second.end() && *it == pos)
+				list->second.erase(it);
+			if (list->second.empty())
+				index.erase(list);
 		}
-		g_syscall(G_FS_WRITE, "}\n", 2, f);
 	}
-	g_syscall(G_FS_FCLOSE_FILE, f);
-	QMM_WRITEQMMLOG(QMMLOG_INFO, "Ent dump written to %s\n", file.c_str());
+
+	// add pos to the new val's list, keeping it sorted
+	if (newval) {
+		EntPosList& list = index[*newval];
+		list.insert(std::lower_bound(list.begin(), list.end(), pos), pos);
+	}
 }
 
 
-// MapEntities private functions
-// =============================
+// apply index_changes. changes are logged in ascending position order, and each position only changes once per key
+// in a single replace pass, so each list is updated with a single sorted merge
+void MapEntities::apply_index_changes() {
+	if (this->index_changes.empty())
+		return;
+
+	// (key, val, pos) for every position leaving or joining a list, grouped by list
+	std::vector<std::tuple<StrId, StrId, size_t>> removes, adds;
+	for (auto& change : this->index_changes) {
+		if (!this->indexes.count(change.key))
+			continue;
+		if (change.has_oldval)
+			removes.emplace_back(change.key, change.oldval, change.pos);
+		if (change.has_newval)
+			adds.emplace_back(change.key, change.newval, change.pos);
+	}
+	this->index_changes.clear();
+	std::sort(removes.begin(), removes.end());
+	std::sort(adds.begin(), adds.end());
+
+	// removes go first, so an entity whose val was set to the same val ends up back in its list
+	EntPosList tmp;
+	for (size_t i = 0; i < removes.size(); ) {
+		StrId key = std::get<0>(removes[i]), val = std::get<1>(removes[i]);
+		size_t end = i;
+		tmp.clear();
+		for (; end < removes.size() && std::get<0>(removes[end]) == key && std::get<1>(removes[end]) == val; end++)
+			tmp.push_back(std::get<2>(removes[end]));
+
+		KeyIndex& index = this->indexes[key];
+		auto list = index.find(val);
+		if (list != index.end()) {
+			EntPosList& positions = list->second;
+			// drop every position in tmp in one pass
+			size_t n = 0, r = 0;
+			for (auto pos : positions) {
+				while (r < tmp.size() && tmp[r] < pos)
+					r++;
+				if (r < tmp.size() && tmp[r] == pos)
+					continue;
+				positions[n++] = pos;
+			}
+			positions.resize(n);
+			if (positions.empty())
+				index.erase(list);
+		}
+		i = end;
+	}
+
+	for (size_t i = 0; i < adds.size(); ) {
+		StrId key = std::get<0>(adds[i]), val = std::get<1>(adds[i]);
+		EntPosList& positions = this->indexes[key][val];
+		size_t mid = positions.size();
+		for (; i < adds.size() && std::get<0>(adds[i]) == key && std::get<1>(adds[i]) == val; i++)
+			positions.push_back(std::get<2>(adds[i]));
+		std::inplace_merge(positions.begin(), positions.begin() + mid, positions.end());
+	}
+}
 
 
-// returns true if "test" has at least all the same keyvals that "contains" has
-bool MapEntities::is_ent_match(Ent& test, Ent& contains) {
-	for (auto& containskeyval : contains.keyvals) {
-		const std::string& matchkey = containskeyval.first;
-		const std::string& matchval = containskeyval.second;
+// test entities against matchers, splitting the work across worker threads if there are any. matched[i] is set
+// if the entity at positions[i] (or at i if positions is nullptr) isn't removed and matches any of matchers.
+// entities are only read here, so edits can be applied afterwards in order, just like a serial pass
+void MapEntities::match_ents(const std::vector<const BoundMatcher*>& matchers, const EntPosList* positions, std::vector<uint8_t>& matched) {
+	size_t count = positions ? positions->size() : this->entlist.size();
+	matched.assign(count, 0);
 
-		// look up matchkey in test ent
-		auto iter = test.keyvals.find(matchkey);
-		// if matchkey doesn't exist in test
-		if (iter == test.keyvals.end()) {
-			// an empty matchval means test should NOT have the matchkey, so continue to the next match keyval
-			if (matchval.empty())
+	auto test = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			size_t pos = positions ? (*positions)[i] : i;
+			if (this->removed[pos])
 				continue;
-			// matchkey missing, test ent doesn't match
-			return false;
+			for (auto matcher : matchers) {
+				if (matcher->match(*this->entlist[pos], *this->pool)) {
+					matched[i] = 1;
+					break;
+				}
+			}
 		}
+	};
+
+	// profile counters aren't thread-safe
+	if (profile_enabled())
+		test(0, count);
+	else
+		threads_for(count, s_match_chunk, test);
+}
 
-		const std::string& testval = iter->second;
 
-		// check matchval for leading and trailing "/" to do a regex match
-		if (matchval[0] == '/' && matchval[matchval.size() - 1] == '/') {
-			// generate a regex pattern using the matchval with leading and trailing "/" removed
-			std::regex pattern(matchval.substr(1, matchval.size() - 2));
-			// testval doesn't match
-			if (!std::regex_match(testval, pattern))
-				return false;
+// removes all entities matching any of the filter masks from internal list
+int MapEntities::filter_ents(const std::vector<BoundMatcher>& filter_list) {
+	EntPosList candidates;
+	std::vector<const BoundMatcher*> unindexed;
+	std::vector<uint8_t> matched;
+	int total = 0;
+
+	// masks that can use the indexes only test the entities found there
+	for (auto& filter : filter_list) {
+		if (!this->find_candidates(filter, candidates)) {
+			unindexed.push_back(&filter);
+			continue;
+		}
+		this->match_ents({ &filter }, &candidates, matched);
+		for (size_t i = 0; i < candidates.size(); i++) {
+			// entities are only tombstoned here, they are removed from entlist in compact()
+			if (matched[i]) {
+				this->removed[candidates[i]] = true;
+				this->num_removed++;
+				total++;
+			}
 		}
-		// no regex, val doesn't match
-		else if (testval != matchval)
-			return false;
 	}
-	return true;
-}
 
+	if (unindexed.empty())
+		return total;
 
-// removes all matching entities from internal list
-int MapEntities::filter_ents(Ent& filterent) {
-	int total = 0;
-	auto it = this->entlist.begin();
-	while (it != this->entlist.end()) {
-		if (is_ent_match(*it, filterent)) {
-			it = this->entlist.erase(it);
+	// the rest of the masks are all tested in a single pass over every entity
+	this->match_ents(unindexed, nullptr, matched);
+	for (size_t pos = 0; pos < matched.size(); pos++) {
+		if (matched[pos]) {
+			this->removed[pos] = true;
+			this->num_removed++;
 			total++;
 		}
-		else
-			++it;
 	}
+
 	return total;
 }
 
 
 // adds an entity to internal list (puts worldspawn at the beginning)
-int MapEntities::add_ent(Ent& addent) {
-	if (addent.classname == "worldspawn")
-		this->entlist.insert(this->entlist.begin(), addent);
-	else
-		this->entlist.push_back(addent);
+int MapEntities::add_ent(const KeyValMap& addent) {
+	Ent ent;
+	for (auto& keyval : addent)
+		ent.set(*this->pool, this->pool->intern(keyval.first), this->pool->intern(keyval.second));
+
+	// new entities always go on the end of entlist so positions don't change. worldspawn is logged
+	// to be moved to the beginning in compact()
+	size_t pos = this->entlist.size();
+	if (this->pool->get(ent.classname) == "worldspawn")
+		this->prepends.push_back(pos);
+
+	this->entlist.push_back(std::make_shared<Ent>(std::move(ent)));
+	this->removed.push_back(false);
+
+	// add new entity to indexes
+	const Ent& added = *this->entlist[pos];
+	for (size_t i = 0; i < added.size(); i++)
+		this->update_index(pos, added.keys[i], nullptr, &added.vals[i]);
+
 	return 1;
 }
 
 
-// finds all entities in internal list matching all stored replaceents and replaces with a withent
-int MapEntities::replace_ents(EntList& replace_entlist, Ent& withent) {
+// finds all entities in internal list matching any stored replace masks and replaces with a withent
+int MapEntities::replace_ents(const std::vector<BoundMatcher>& replace_list, const KeyValMap& withent) {
 	int total = 0;
-	// go through all replace_ents
-	for (auto& repent : replace_entlist) {
-		// go through all ents in internal list
-		for (auto& ent : this->entlist) {
-			// find any matching ent; empty repent matches all
-			if (repent.keyvals.empty() || is_ent_match(ent, repent)) {
+	EntPosList candidates;
+	std::vector<uint8_t> matched;
+
+	// intern withent's keyvals once up front
+	std::vector<std::pair<StrId, StrId>> withids;
+	for (auto& keyval : withent)
+		withids.emplace_back(this->pool->intern(keyval.first), this->pool->intern(keyval.second));
+
+	// go through all replace masks
+	for (auto& replace : replace_list) {
+		// only test entities found in the indexes if possible, otherwise test all ents in internal list.
+		// candidates is a copy, so it is safe to iterate while replace_ent updates the indexes
+		const EntPosList* positions = this->find_candidates(replace, candidates) ? &candidates : nullptr;
+
+		// find all matching ents first (empty mask matches all). replace_ent only changes the ent it
+		// is given, so this doesn't change which ents match
+		this->match_ents({ &replace }, positions, matched);
+
+		for (size_t i = 0; i < matched.size(); i++) {
+			if (matched[i]) {
 				total++;
 				// replace with withent
-				replace_ent(ent, withent);
+				this->replace_ent(positions ? candidates[i] : i, withids);
 			}
 		}
+
+		// the next mask may look up candidates in the indexes
+		this->apply_index_changes();
 	}
 	return total;
 }
 
 
-// adds all keyvals from withent into replaceent (replacing the val if a key already exists)
-void MapEntities::replace_ent(Ent& replaceent, Ent& withent) {
+// adds all keyvals from withent into the ent at pos (replacing the val if a key already exists)
+void MapEntities::replace_ent(size_t pos, const std::vector<std::pair<StrId, StrId>>& withent) {
+	Ent& replaceent = this->edit_ent(pos);
 	// go through all keyvals on withent
-	for (auto& withkeyval : withent.keyvals) {
+	for (auto& withkeyval : withent) {
+		StrId withkey = withkeyval.first;
+		StrId withval = withkeyval.second;
+		const StrId* oldval = replaceent.get(withkey);
 		// empty val means to remove key if it exists
-		if (withkeyval.second.empty())
-			replaceent.keyvals.erase(withkeyval.first);
-		// add/replace val on replaceent
-		else
-			replaceent.keyvals[withkeyval.first] = withkeyval.second;
-	}
-}
-
-
-// generate a tokenlist from entstring
-TokenList MapEntities::tokenlist_from_entstring(const EntString& entstring) {
-	TokenList tokenlist;
-	std::string build;
-
-	for (size_t i = 0; i < entstring.size(); i++) {
-		auto& c = entstring[i];
-		// whitespace: end current token
-		if (std::isspace(c)) {
-			if (!build.empty())
-				tokenlist.push_back(build);
-			build.clear();
-		}
-		// non-printable characters, just skip it
-		else if (c < ' ' || c == 127) {
-			continue;
-		}
-		// closing braces: end current token
-		else if (c == '{') {
-			if (!build.empty())
-				tokenlist.push_back(build);
-			build.clear();
-			tokenlist.push_back("{");
-		}
-		// closing braces: end current token
-		else if (c == '}') {
-			if (!build.empty())
-				tokenlist.push_back(build);
-			build.clear();
-			tokenlist.push_back("}");
-		}
-		// quotes: end current token
-		// then scan forward until next quote and store whole string as 1 token
-		else if (c == '"') {
-			if (!build.empty())
-				tokenlist.push_back(build);
-			build.clear();
-
-			i++;
-			size_t start = i;
-			while (i < entstring.size() && entstring[i] != '"')
-				i++;
-			tokenlist.push_back(entstring.substr(start, i - start));
+		if (withval == str_empty) {
+			if (oldval) {
+				this->index_changes.push_back({ withkey, pos, *oldval, str_empty, true, false });
+				replaceent.erase(withkey);
+			}
 		}
-		// all other characters, add to build string
+		// add/replace val on replaceent
 		else {
-			build += c;
+			this->index_changes.push_back({ withkey, pos, oldval ? *oldval : str_empty, withval, oldval != nullptr, true });
+			replaceent.set(*this->pool, withkey, withval);
 		}
 	}
-
-	// any remaining token being built
-	if (!build.empty())
-		tokenlist.push_back(build);
-
-	return tokenlist;
 }
 
 
-// generate a tokenlist from engine tokens
-TokenList MapEntities::tokenlist_from_engine() {
-	TokenList tokenlist;
-	char buf[MAX_TOKEN_CHARS];
+// incremental entity parser, fed one token at a time from either an entstring or the engine
+class EntParser {
+	public:
+		EntParser(StringPool& pool, EntList& entlist) : pool(pool), entlist(entlist) { }
 
-	// get tokens from engine/QMM and add to tokenlist
-	while (g_syscall(G_GET_ENTITY_TOKEN, buf, sizeof(buf))) {
-		buf[sizeof(buf) - 1] = '\0';
-		tokenlist.push_back(buf);
-	}
+		// handle the next token, returns false if the token stream is malformed and parsing should stop
+		bool feed(std::string_view token) {
+			char c = token.empty() ? '\0' : token[0];
 
-	return tokenlist;
-}
+			// got an opening brace while already inside an entity, error
+			if (c == '{' && this->inside_ent)
+				return false;
 
+			// got a closing brace when not inside an entity, error
+			if (c == '}' && !this->inside_ent)
+				return false;
 
-// generate a tokenlist from entlist
-TokenList MapEntities::tokenlist_from_entlist(const EntList& entlist) {
-	TokenList tokenlist;
+			// if this is a closing brace when expecting a val, error
+			if (c == '}' && !this->is_key)
+				return false;
 
-	// for every entity, add a "{", all the keyvals, and "}"
-	for (auto& ent : entlist) {
-		tokenlist.push_back("{");
-		for (auto& keyval : ent.keyvals) {
-			tokenlist.push_back(keyval.first);
-			tokenlist.push_back(keyval.second);
-		}
-		tokenlist.push_back("}");
-	}
+			// if this is a valid closing brace, save ent to list and continue
+			if (c == '}') {
+				this->inside_ent = false;
+				this->entlist.push_back(std::make_shared<Ent>(std::move(this->ent)));
+				this->ent = {};
+				return true;
+			}
 
-	return tokenlist;
-}
+			// if this is a valid opening brace, start a new ent
+			if (c == '{') {
+				this->inside_ent = true;
+				this->is_key = true;
+				this->ent = {};
+				return true;
+			}
 
+			// this is a key
+			if (this->is_key) {
+				this->is_key = false;
+				this->key = this->pool.intern(token);
+			}
+			// this is a val
+			else {
+				this->is_key = true;
+				// store keyval in ent (this also stores classname for easier lookup)
+				this->ent.set(this->pool, this->key, this->pool.intern(token));
+			}
 
-// generate an entlist from engine tokens
-EntList MapEntities::entlist_from_tokenlist(const TokenList& tokenlist) {
-	EntList entlist;
+			return true;
+		}
 
-	// the current ent
-	Ent ent;
-	// store key. when a val is received, make a new entry into ent
-	std::string key;
+	private:
+		StringPool& pool;
+		EntList& entlist;
 
-	// each token from list
-	std::string token;
-	TokenList::const_iterator iter = tokenlist.begin();
+		// the current ent
+		Ent ent;
+		// store key. when a val is received, make a new entry into ent
+		StrId key = str_empty;
 
-	bool inside_ent = false;	// false = between ents, true = inside an ent
-	bool is_key = true;			// true = expecting key, false = expecting val
+		bool inside_ent = false;	// false = between ents, true = inside an ent
+		bool is_key = true;			// true = expecting key, false = expecting val
+};
 
-	// loop through all tokens from engine
-	while (iter != tokenlist.end()) {
-		token = *(iter++);
 
-		// got an opening brace while already inside an entity, error
-		if (token[0] == '{' && inside_ent)
-			break;
+// generate an entlist from entstring
+EntList MapEntities::entlist_from_entstring(StringPool& pool, std::string_view entstring) {
+	EntList entlist;
+	EntParser parser(pool, entlist);
+	Tokenizer tokens(entstring);
+	std::string_view token;
 
-		// got a closing brace when not inside an entity, error
-		if (token[0] == '}' && !inside_ent)
+	// loop through all tokens in entstring
+	while (tokens.next(token)) {
+		if (!parser.feed(token))
 			break;
+	}
 
-		// if this is a closing brace when expecting a val, error
-		if (token[0] == '}' && !is_key)
-			break;
+	return entlist;
+}
 
-		// if this is a valid closing brace, save ent to list and continue
-		if (token[0] == '}') {
-			inside_ent = false;
-			key = "";
-			entlist.push_back(ent);
-			ent = {};
-			continue;
-		}
 
-		// if this is a valid opening brace, start a new ent
-		if (token[0] == '{') {
-			inside_ent = true;
-			is_key = true;
-			key = "";
-			ent = {};
-			continue;
-		}
+// generate an entlist from engine tokens
+EntList MapEntities::entlist_from_engine(StringPool& pool, uint64_t& hash) {
+	EntList entlist;
+	EntParser parser(pool, entlist);
+	bool ok = true;
+	char buf[MAX_TOKEN_CHARS];
 
-		// this is a key
-		if (is_key) {
-			is_key = false;
-			key = token;
-		}
-		// this is a val
-		else {
-			is_key = true;
-			// store keyval in ent
-			ent.keyvals[key] = token;
-			// store classname for easier lookup
-			if (key == "classname")
-				ent.classname = token;
-		}
-	} // while(1)
+	// get tokens from engine/QMM and parse as they arrive. keep pulling after an error so the
+	// engine's token stream is always fully consumed
+	hash = hash_fnv1a({});
+	while (g_syscall(G_GET_ENTITY_TOKEN, buf, sizeof(buf))) {
+		buf[sizeof(buf) - 1] = '\0';
+		// include the null terminator so token boundaries are part of the hash
+		hash = hash_fnv1a(std::string_view(buf, strlen(buf) + 1), hash);
+		if (ok)
+			ok = parser.feed(buf);
+	}
 
 	return entlist;
 }
 
 
 // generate an entstring from entlist
-EntString MapEntities::entstring_from_entlist(const EntList& entlist) {
+EntString MapEntities::entstring_from_entlist(const StringPool& pool, const EntList& entlist) {
 	EntString entstring;
-
-	// for every entity, add a "{", all the keyvals, and "}" 
-	for (auto& ent : entlist) {
-		entstring += "{\n";
-		for (auto& keyval : ent.keyvals) {
-			entstring += ("\"" + keyval.first + "\" \"" + keyval.second + "\"\n");
-		}
-		entstring += "}\n";
-	}
-
+	s_serialize(entlist, [&pool](StrId id) { return pool.get(id); }, false, entstring);
 	return entstring;
 }
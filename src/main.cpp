@@ -12,8 +12,20 @@ Created By:
 #include "version.h"
 #include <qmmapi.h>
 #include <cstring>
+#include <map>
+#include <vector>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <future>
+#include <utility>
+#include <algorithm>
 #include "game.h"
 #include "ent.h"
+#include "rules.h"
+#include "stats.h"
+#include "strpool.h"
+#include "threads.h"
 #include "util.h"
 
 plugin_res* g_result = nullptr;
@@ -52,7 +64,56 @@ C_DLLEXPORT int QMM_Attach(eng_syscall engfunc, mod_vmMain modfunc, plugin_res*
 }
 
 
+// a stripper_dump running on a worker thread. the entity lists are copied when the command is run, and the files are
+// written on the game thread once they have been serialized
+struct DumpJob {
+	std::string mapfile;
+	std::string modfile;
+	std::future<std::pair<std::string, std::string>> buffers;
+};
+static std::unique_ptr<DumpJob> s_dump_job;
+// dump the main map and SubBSP entity lists to files, either now or on a worker thread
+static void s_dump(bool async);
+// write out the files from a finished background dump
+static void s_finish_dump();
+// write the changes between the map and mod entity lists as a stripper config
+static void s_dump_delta();
+
+// entity lists after running the first few rules of a config with stripper_test
+struct TestCheckpoint {
+	size_t rules = 0;
+	std::map<intptr_t, MapEntities> lists;
+	int num_filtered = 0, num_added = 0, num_replaced = 0;
+};
+// stripper_test keeps checkpoints between runs of the same config, so a run only has to re-run the rules from the
+// first one that changed. entities are shared between checkpoints, so they are cheap to keep
+struct TestState {
+	std::string file;
+	// lists the checkpoints were made from
+	std::shared_ptr<StringPool> pool;
+	size_t num_lists = 0;
+	// hashes of the rules in the last run
+	std::vector<uint64_t> rule_hashes;
+	// in order of rules run, the first is the original lists
+	std::vector<TestCheckpoint> checkpoints;
+};
+static TestState s_test;
+// most checkpoints made in a single stripper_test run
+static const size_t s_test_checkpoints = 16;
+// apply a config to copies of the original entity lists and report the changes, optionally dumping the result
+static void s_test_config(const std::string& file, bool dump);
+// write binary rule files for a config, or for the global config and every map config
+static void s_compile_configs(const std::string& file);
+// return the global config and every map config (or just the current map's config if the engine can't list files)
+static std::vector<std::string> s_config_files();
+
+
 C_DLLEXPORT void QMM_Detach() {
+	// background work must be finished before the DLL is unloaded (an unfinished dump is dropped)
+	s_dump_job = nullptr;
+	RuleProgram::wait_precompile();
+	// worker threads must be stopped before the DLL is unloaded
+	threads_set_count(0);
 }
 
 
@@ -69,16 +130,41 @@ static std::map<intptr_t, MapEntities> s_subbsp_mapents;
 static std::map<intptr_t, MapEntities> s_subbsp_modents;
 // store active subbsp index
 static int s_subbsp_index = -1;
+// string pool shared by all entity lists for the current map (including subbsps)
+static std::shared_ptr<StringPool> s_pool;
+
+// time spent and number of tokens passed to the mod with G_GET_ENTITY_TOKEN since the last entity list was loaded
+static double s_token_ms = 0;
+static int s_token_count = 0;
+// set when an entity list is loaded, so token stats are only recorded once per list
+static bool s_token_stats_pending = false;
 
 
 // handle retrieving map entities, loading stripper configs, and modifying entities for normal Init/SpawnEntities mod loading
 static bool s_load_and_modify_ents();
+// load stripper configs and apply them to a copy of mapents (or load the result from the cache)
+static MapEntities s_modify_ents(const MapEntities& mapents);
+// return name for a stat, separating SubBSP stats from main map stats
+static const char* s_stat_name(const char* name);
+
+#if defined(GAME_HAS_FS_GETFILELIST)
+// set once configs have been sent to be compiled in the background (on the first GAME_INIT)
+static bool s_precompile_started = false;
+// set while configs are still compiling in the background
+static bool s_precompiling = false;
+// find all map configs and start compiling them (and the global config) in the background
+static void s_precompile_configs();
+#endif
 
 
 C_DLLEXPORT intptr_t QMM_vmMain(intptr_t cmd, intptr_t* args) {
 	if (s_disabled)
 		QMM_RET_IGNORED(0);
 
+	// write out a background stripper_dump once it is done
+	if (s_dump_job && s_dump_job->buffers.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		s_finish_dump();
+
 	if (cmd == GAME_INIT) {
 		// broadcast our version so other stripper plugins may disable themselves
 		QMM_PLUGIN_BROADCAST(STRIPPER_QMM_BROADCAST_STR, nullptr, STRIPPER_QMM_VERSION_INT);
@@ -90,10 +176,21 @@ C_DLLEXPORT intptr_t QMM_vmMain(intptr_t cmd, intptr_t* args) {
 		QMM_WRITEQMMLOG(QMMLOG_NOTICE, "Stripper v" STRIPPER_QMM_VERSION " (%s) by " STRIPPER_QMM_BUILDER " is loaded\n", QMM_GETGAMEENGINE());
 		// register cvar
 		g_syscall(G_CVAR_REGISTER, nullptr, "stripper_version", STRIPPER_QMM_VERSION, CVAR_ROM | CVAR_SERVERINFO | CVAR_NORESTART);
+		g_syscall(G_CVAR_REGISTER, nullptr, "stripper_cache", "1", CVAR_ARCHIVE);
+		g_syscall(G_CVAR_REGISTER, nullptr, "stripper_profile", "0", 0);
+		g_syscall(G_CVAR_REGISTER, nullptr, "stripper_threads", "0", CVAR_ARCHIVE);
 
 		// get mapname cvar if it exists
 		mapname = QMM_GETSTRCVAR("mapname");
 
+#if defined(GAME_HAS_FS_GETFILELIST)
+		// compile every config in the background when the server starts, so they are ready when their maps load
+		if (!s_precompile_started) {
+			s_precompile_started = true;
+			s_precompile_configs();
+		}
+#endif
+
 #if !defined(GAME_HAS_SPAWN_ENTITIES)
 		// games without a GAME_SPAWN_ENTITIES msg get entities and load configs here during QMM_vmMain(GAME_INIT).
 		// entities are passed to the mod with the QMM_syscall(G_GET_ENTITY_TOKEN) hook
@@ -106,32 +203,68 @@ C_DLLEXPORT intptr_t QMM_vmMain(intptr_t cmd, intptr_t* args) {
 	}
 	// handle stripper_dump command
 	else if (cmd == GAME_CONSOLE_COMMAND) {
-		const char* arg = QMM_ARGV2(0);
+		int argn = 0;
+		const char* arg = QMM_ARGV2(argn);
 		
 		// if command is "sv", then check the next arg
 		if (str_striequal(arg, "sv"))
-			arg = QMM_ARGV2(1);
+			arg = QMM_ARGV2(++argn);
 
 		if (str_striequal(arg, "stripper_dump") || str_striequal(arg, "/stripper_dump")) {
-			std::string mapfile = QMM_VARARGS("qmmaddons/stripper/dumps/%s.txt", mapname.c_str());
-			std::string modfile = QMM_VARARGS("qmmaddons/stripper/dumps/%s_modents.txt", mapname.c_str());
+			// "stripper_dump async" serializes the entity lists on a worker thread, so the command returns right away.
+			// "stripper_dump delta" only writes the changes between the map and mod entity lists
+			bool async = false, delta = false;
+			for (int i = argn + 1; i < argn + 3; i++) {
+				if (str_striequal(QMM_ARGV2(i), "async"))
+					async = true;
+				else if (str_striequal(QMM_ARGV2(i), "delta"))
+					delta = true;
+			}
+			if (delta)
+				s_dump_delta();
+			else
+				s_dump(async);
 
-			// print out the main map ent lists first
-			s_subbsp_mapents[-1].dump_to_file(mapfile);
-			s_subbsp_modents[-1].dump_to_file(modfile);
+			// don't pass this to mod since we handled the command
+			QMM_RET_SUPERCEDE(1);
+		}
+		else if (str_striequal(arg, "stripper_test") || str_striequal(arg, "/stripper_test")) {
+			// "stripper_test <file> [dump]" applies a config to the map's original entities without changing the game
+			std::string file = QMM_ARGV2(argn + 1);
+			if (file.empty())
+				QMM_WRITEQMMLOG(QMMLOG_NOTICE, "Usage: stripper_test <file> [dump]\n");
+			else
+				s_test_config(file, str_striequal(QMM_ARGV2(argn + 2), "dump"));
 
-			// we also need to print out the subbsp lists (true = append, skip -1)
-			for (auto& subbsp : s_subbsp_mapents)
-				if (subbsp.first != -1)
-					subbsp.second.dump_to_file(mapfile, true);
-			for (auto& subbsp : s_subbsp_modents)
-				if (subbsp.first != -1)
-					subbsp.second.dump_to_file(modfile, true);
+			// don't pass this to mod since we handled the command
+			QMM_RET_SUPERCEDE(1);
+		}
+		else if (str_striequal(arg, "stripper_compile") || str_striequal(arg, "/stripper_compile")) {
+			// "stripper_compile [file]" writes binary rule files, which are loaded instead of the .ini files
+			s_compile_configs(QMM_ARGV2(argn + 1));
+
+			// don't pass this to mod since we handled the command
+			QMM_RET_SUPERCEDE(1);
+		}
+		else if (str_striequal(arg, "stripper_stats") || str_striequal(arg, "/stripper_stats")) {
+			stats_print();
+
+			// don't pass this to mod since we handled the command
+			QMM_RET_SUPERCEDE(1);
+		}
+		else if (str_striequal(arg, "stripper_report") || str_striequal(arg, "/stripper_report")) {
+			profile_print();
 
 			// don't pass this to mod since we handled the command
 			QMM_RET_SUPERCEDE(1);
 		}
 	}
+#if defined(GAME_HAS_FS_GETFILELIST)
+	// log any warnings from background compiles as they finish
+	else if (cmd == GAME_RUN_FRAME && s_precompiling) {
+		s_precompiling = RuleProgram::poll_precompile();
+	}
+#endif
 
 #if defined(GAME_HAS_SPAWN_ENTITIES)
 
@@ -164,7 +297,9 @@ C_DLLEXPORT intptr_t QMM_vmMain(intptr_t cmd, intptr_t* args) {
 
 		if (s_load_and_modify_ents()) {
 			// generate new entstring from s_modents to pass to mod
+			StatTimer timer;
 			const char* entstring = s_subbsp_modents[-1].get_entstring().c_str();
+			stats_time("serialize entstring", timer.ms());
 
 			// replace entstring arg for passing to mod
 			args[entarg] = (intptr_t)entstring;
@@ -186,7 +321,18 @@ C_DLLEXPORT intptr_t QMM_syscall(intptr_t cmd, intptr_t* args) {
 	if (cmd == G_GET_ENTITY_TOKEN) {
 		char* entity = (char*)args[0];
 		intptr_t length = args[1];
+		StatTimer timer;
 		intptr_t ret = s_subbsp_modents[s_subbsp_index].get_next_token(entity, length);
+		s_token_ms += timer.ms();
+
+		// record token stats once the mod has received all the tokens
+		if (ret)
+			s_token_count++;
+		else if (s_token_stats_pending) {
+			stats_time(s_stat_name("deliver tokens"), s_token_ms);
+			stats_count(s_stat_name("tokens to mod"), s_token_count);
+			s_token_stats_pending = false;
+		}
 
 		if (ret && s_subbsp_index >= 0)
 			QMM_WRITEQMMLOG(QMMLOG_TRACE, "G_GET_ENTITY_TOKEN: Passing SubBSP %d entity to mod: \"%s\"\n", s_subbsp_index, entity);
@@ -262,10 +408,14 @@ C_DLLEXPORT intptr_t QMM_syscall_Post(intptr_t cmd, intptr_t* args) {
 
 		QMM_WRITEQMMLOG(QMMLOG_DEBUG, "Parsing SubBSP entity list %d\n", s_subbsp_index);
 
+		StatTimer total_timer;
+
 		// get the entities from the engine and save to mapents
-		MapEntities mapents;
+		MapEntities mapents(s_pool);
 		// load entities from G_GET_ENTITY_TOKEN
+		StatTimer timer;
 		mapents.make_from_engine();
+		stats_time(s_stat_name("load entities"), timer.ms());
 
 		// check for valid entity list
 		if (mapents.get_entlist().empty()) {
@@ -274,28 +424,32 @@ C_DLLEXPORT intptr_t QMM_syscall_Post(intptr_t cmd, intptr_t* args) {
 		}
 
 		QMM_WRITEQMMLOG(QMMLOG_DEBUG, "SubBSP entity list %d loaded, found %d entities\n", s_subbsp_index, mapents.get_entlist().size());
+		stats_count(s_stat_name("entities from engine"), (double)mapents.get_entlist().size());
 
-		// modents starts as a copy of mapents
-		MapEntities modents = mapents;
-
-		// load global config
-		QMM_WRITEQMMLOG(QMMLOG_DEBUG, "Loading global config for SubBSP entity list %d\n", s_subbsp_index);
-		modents.apply_config("qmmaddons/stripper/global.ini");
-
-		// load map-specific config
-		QMM_WRITEQMMLOG(QMMLOG_DEBUG, "Loading map-specific config for SubBSP entity list %d: %s\n", s_subbsp_index, mapname.c_str());
-		modents.apply_config(QMM_VARARGS("qmmaddons/stripper/maps/%s.ini", mapname.c_str()));
+		// apply configs
+		MapEntities modents = s_modify_ents(mapents);
 
 		QMM_WRITEQMMLOG(QMMLOG_DEBUG, "Completed parsing SubBSP entity list %d, passing %d entities to mod\n", s_subbsp_index, modents.get_entlist().size());
 
+		stats_count(s_stat_name("entities to mod"), (double)modents.get_entlist().size());
+
 		// generate new entstring from modents to pass to mod
 		static EntString entstring;
+		timer = StatTimer();
 		entstring = modents.get_entstring();
+		stats_time(s_stat_name("serialize entstring"), timer.ms());
 
 		// store these ent lists in subbsp tables
 		s_subbsp_mapents[s_subbsp_index] = std::move(mapents);
 		s_subbsp_modents[s_subbsp_index] = std::move(modents);
 
+		// start counting tokens passed to the mod for this list (JAMP gets SubBSP entities with G_GET_ENTITY_TOKEN)
+		s_token_ms = 0;
+		s_token_count = 0;
+		s_token_stats_pending = true;
+
+		stats_time(s_stat_name("total"), total_timer.ms());
+
 		// engine has already been called, just change the return value back to the mod
 		// this is fine even in JAMP since trap_SetActiveSubBSP is void so return value is ignored
 		QMM_RET_OVERRIDE((intptr_t)entstring.c_str());
@@ -328,9 +482,21 @@ C_DLLEXPORT void QMM_PluginMessage(plugin_id from_plid, const char* message, voi
 
 // handle retrieving map entities, loading stripper configs, and modifying entities
 static bool s_load_and_modify_ents() {
+	StatTimer total_timer;
+
 	// some games can load new maps without unloading the mod DLL, so start fresh
 	s_subbsp_mapents.clear();
 	s_subbsp_modents.clear();
+	s_test = {};
+	// this frees all strings from the previous map at once
+	s_pool = std::make_shared<StringPool>();
+
+	// start a new config profile if profiling is enabled. SubBSPs are added to the main map's profile
+	profile_enable(QMM_GETINTCVAR("stripper_profile") != 0);
+	profile_clear();
+
+	// start or stop worker threads for matching
+	threads_set_count(QMM_GETINTCVAR("stripper_threads"));
 
 	// get all the entity tokens from the engine and save to s_mapents
 	QMM_WRITEQMMLOG(QMMLOG_DEBUG, "Parsing entity list\n");
@@ -339,9 +505,11 @@ static bool s_load_and_modify_ents() {
 	// so we can just use it for all games
 
 	// get the entities from the engine and save to mapents
-	MapEntities mapents;
+	MapEntities mapents(s_pool);
 	// load entities from G_GET_ENTITY_TOKEN
+	StatTimer timer;
 	mapents.make_from_engine();
+	stats_time("load entities", timer.ms());
 
 	// check for valid entity list
 	if (mapents.get_entlist().empty()) {
@@ -350,23 +518,326 @@ static bool s_load_and_modify_ents() {
 	}
 
 	QMM_WRITEQMMLOG(QMMLOG_INFO, "Entity list loaded, found %d entities\n", mapents.get_entlist().size());
+	stats_count("entities from engine", (double)mapents.get_entlist().size());
 
-	// modents starts as a copy of mapents
-	MapEntities modents = mapents;
+	// apply configs
+	MapEntities modents = s_modify_ents(mapents);
 
-	// load global config
-	QMM_WRITEQMMLOG(QMMLOG_INFO, "Loading global config\n");
-	modents.apply_config("qmmaddons/stripper/global.ini");
-
-	// load map-specific config
-	QMM_WRITEQMMLOG(QMMLOG_INFO, "Loading map-specific config: %s\n", mapname.c_str());
-	modents.apply_config(QMM_VARARGS("qmmaddons/stripper/maps/%s.ini", mapname.c_str()));
-		
 	QMM_WRITEQMMLOG(QMMLOG_INFO, "Completed parsing entity list, passing %d entities to mod\n", modents.get_entlist().size());
+	stats_count("entities to mod", (double)modents.get_entlist().size());
 
 	// store these ent lists in subbsp tables
 	s_subbsp_mapents[s_subbsp_index] = std::move(mapents);
 	s_subbsp_modents[s_subbsp_index] = std::move(modents);
 
+	// start counting tokens passed to the mod for this list
+	s_token_ms = 0;
+	s_token_count = 0;
+	s_token_stats_pending = true;
+
+	stats_time("total", total_timer.ms());
+
 	return true;
 }
+
+
+// load stripper configs and apply them to a copy of mapents. the result only depends on the entities from the engine
+// and the contents of the configs, so it is saved to a cache file and re-used if the same map is loaded again with the
+// same configs (e.g. map restarts and map rotation)
+static MapEntities s_modify_ents(const MapEntities& mapents) {
+	std::string globalfile = "qmmaddons/stripper/global.ini";
+	std::string mapfile = QMM_VARARGS("qmmaddons/stripper/maps/%s.ini", mapname.c_str());
+
+	// load global config
+	if (s_subbsp_index < 0)
+		QMM_WRITEQMMLOG(QMMLOG_INFO, "Loading global config\n");
+	else
+		QMM_WRITEQMMLOG(QMMLOG_DEBUG, "Loading global config for SubBSP entity list %d\n", s_subbsp_index);
+	StatTimer timer;
+	std::shared_ptr<const RuleProgram> globalcfg = RuleProgram::load(globalfile);
+	stats_time(s_stat_name("load global config"), timer.ms());
+
+	// load map-specific config
+	if (s_subbsp_index < 0)
+		QMM_WRITEQMMLOG(QMMLOG_INFO, "Loading map-specific config: %s\n", mapname.c_str());
+	else
+		QMM_WRITEQMMLOG(QMMLOG_DEBUG, "Loading map-specific config for SubBSP entity list %d: %s\n", s_subbsp_index, mapname.c_str());
+	timer = StatTimer();
+	std::shared_ptr<const RuleProgram> mapcfg = RuleProgram::load(mapfile);
+	stats_time(s_stat_name("load map config"), timer.ms());
+
+	// cache key covers everything that affects the result. a missing config is different from an empty one
+	std::string keystr = QMM_VARARGS("%X %016llx %d %016llx %d %016llx", STRIPPER_QMM_VERSION_INT, (unsigned long long)mapents.get_source_hash(),
+		globalcfg ? 1 : 0, (unsigned long long)(globalcfg ? globalcfg->hash : 0),
+		mapcfg ? 1 : 0, (unsigned long long)(mapcfg ? mapcfg->hash : 0));
+	uint64_t key = hash_fnv1a(keystr);
+
+	// only 1 cache file is kept for each map (and subbsp)
+	std::string cachefile;
+	if (s_subbsp_index < 0)
+		cachefile = QMM_VARARGS("qmmaddons/stripper/cache/%s.txt", mapname.c_str());
+	else
+		cachefile = QMM_VARARGS("qmmaddons/stripper/cache/%s_subbsp%d.txt", mapname.c_str(), s_subbsp_index);
+
+	// configs need to actually be applied to be profiled
+	bool use_cache = QMM_GETINTCVAR("stripper_cache") != 0 && !profile_enabled();
+
+	MapEntities modents(s_pool);
+	timer = StatTimer();
+	if (use_cache && modents.load_cache(cachefile, key)) {
+		// entities the configs didn't change are shared with mapents, just like after applying them
+		modents.share_ents(mapents);
+		stats_time(s_stat_name("load cache"), timer.ms());
+		QMM_WRITEQMMLOG(QMMLOG_INFO, "Loaded modified entity list from cache %s\n", cachefile.c_str());
+		return modents;
+	}
+
+	// modents starts as a copy of mapents
+	timer = StatTimer();
+	modents = mapents;
+	stats_time(s_stat_name("copy entities"), timer.ms());
+
+	if (globalcfg) {
+		timer = StatTimer();
+		modents.apply_config(*globalcfg, globalfile);
+		stats_time(s_stat_name("apply global config"), timer.ms());
+	}
+	if (mapcfg) {
+		timer = StatTimer();
+		modents.apply_config(*mapcfg, mapfile);
+		stats_time(s_stat_name("apply map config"), timer.ms());
+	}
+
+	if (use_cache) {
+		timer = StatTimer();
+		modents.save_cache(cachefile, key);
+		stats_time(s_stat_name("save cache"), timer.ms());
+	}
+
+	return modents;
+}
+
+
+// dump the main map and SubBSP entity lists to files (main map first, then SubBSPs), either now or on a worker thread
+static void s_dump(bool async) {
+	std::string mapfile = QMM_VARARGS("qmmaddons/stripper/dumps/%s.txt", mapname.c_str());
+	std::string modfile = QMM_VARARGS("qmmaddons/stripper/dumps/%s_modents.txt", mapname.c_str());
+
+	if (!async) {
+		StatTimer timer;
+		std::string mapbuf, modbuf;
+		// print out the main map ent lists first
+		s_subbsp_mapents[-1].dump_to_buffer(mapbuf);
+		s_subbsp_modents[-1].dump_to_buffer(modbuf);
+
+		// we also need to print out the subbsp lists (skip -1)
+		for (auto& subbsp : s_subbsp_mapents)
+			if (subbsp.first != -1)
+				subbsp.second.dump_to_buffer(mapbuf);
+		for (auto& subbsp : s_subbsp_modents)
+			if (subbsp.first != -1)
+				subbsp.second.dump_to_buffer(modbuf);
+
+		MapEntities::write_dump(mapfile, mapbuf);
+		MapEntities::write_dump(modfile, modbuf);
+		stats_time("dump", timer.ms());
+		return;
+	}
+
+	if (s_dump_job) {
+		QMM_WRITEQMMLOG(QMMLOG_NOTICE, "A stripper_dump is already in progress\n");
+		return;
+	}
+
+	// copy the lists in the same order as above
+	StatTimer timer;
+	std::vector<EntSnapshot> mapsnaps, modsnaps;
+	mapsnaps.push_back(s_subbsp_mapents[-1].get_snapshot());
+	modsnaps.push_back(s_subbsp_modents[-1].get_snapshot());
+	for (auto& subbsp : s_subbsp_mapents)
+		if (subbsp.first != -1)
+			mapsnaps.push_back(subbsp.second.get_snapshot());
+	for (auto& subbsp : s_subbsp_modents)
+		if (subbsp.first != -1)
+			modsnaps.push_back(subbsp.second.get_snapshot());
+	stats_time("dump snapshot", timer.ms());
+
+	s_dump_job = std::make_unique<DumpJob>();
+	s_dump_job->mapfile = mapfile;
+	s_dump_job->modfile = modfile;
+	s_dump_job->buffers = std::async(std::launch::async, [mapsnaps = std::move(mapsnaps), modsnaps = std::move(modsnaps)] {
+		std::pair<std::string, std::string> buffers;
+		for (auto& snapshot : mapsnaps)
+			MapEntities::dump_snapshot(snapshot, buffers.first);
+		for (auto& snapshot : modsnaps)
+			MapEntities::dump_snapshot(snapshot, buffers.second);
+		return buffers;
+	});
+
+	QMM_WRITEQMMLOG(QMMLOG_INFO, "Writing ent dumps in the background\n");
+}
+
+
+// write out the files from a finished background dump
+static void s_finish_dump() {
+	std::pair<std::string, std::string> buffers = s_dump_job->buffers.get();
+
+	StatTimer timer;
+	MapEntities::write_dump(s_dump_job->mapfile, buffers.first);
+	MapEntities::write_dump(s_dump_job->modfile, buffers.second);
+	stats_time("dump write", timer.ms());
+
+	s_dump_job = nullptr;
+}
+
+
+// write the changes between the map and mod entity lists as a stripper config (main map first, then SubBSPs)
+static void s_dump_delta() {
+	std::string deltafile = QMM_VARARGS("qmmaddons/stripper/dumps/%s_delta.txt", mapname.c_str());
+
+	StatTimer timer;
+	std::string buf;
+	s_subbsp_mapents[-1].dump_delta(s_subbsp_modents[-1], buf);
+	for (auto& subbsp : s_subbsp_mapents)
+		if (subbsp.first != -1)
+			subbsp.second.dump_delta(s_subbsp_modents[subbsp.first], buf);
+
+	MapEntities::write_dump(deltafile, buf);
+	stats_time("dump delta", timer.ms());
+}
+
+
+// apply a config to copies of the original entity lists and report the changes, optionally dumping the result
+static void s_test_config(const std::string& file, bool dump) {
+	if (s_subbsp_mapents.empty()) {
+		QMM_WRITEQMMLOG(QMMLOG_NOTICE, "stripper_test: No entities loaded\n");
+		return;
+	}
+
+	StatTimer timer;
+	std::shared_ptr<const RuleProgram> program = RuleProgram::load(file);
+	double load_ms = timer.ms();
+	if (!program) {
+		QMM_WRITEQMMLOG(QMMLOG_NOTICE, "stripper_test: Unable to load %s\n", file.c_str());
+		return;
+	}
+	const std::vector<Rule>& rules = program->rules;
+
+	// start over with a different config or a new map
+	if (s_test.file != file || s_test.pool != s_pool || s_test.num_lists != s_subbsp_mapents.size()) {
+		s_test = {};
+		s_test.file = file;
+		s_test.pool = s_pool;
+		s_test.num_lists = s_subbsp_mapents.size();
+		TestCheckpoint original;
+		original.lists = s_subbsp_mapents;
+		s_test.checkpoints.push_back(std::move(original));
+	}
+
+	// rules before the first changed rule give the same result as last time, so start from the last checkpoint
+	// before it
+	size_t same = 0;
+	while (same < rules.size() && same < s_test.rule_hashes.size() && rules[same].hash == s_test.rule_hashes[same])
+		same++;
+	while (s_test.checkpoints.back().rules > same)
+		s_test.checkpoints.pop_back();
+
+	timer = StatTimer();
+	TestCheckpoint result = s_test.checkpoints.back();
+	size_t start = result.rules;
+	size_t interval = std::max<size_t>(1, rules.size() / s_test_checkpoints);
+	while (result.rules < rules.size()) {
+		size_t end = std::min(rules.size(), (result.rules / interval + 1) * interval);
+		for (auto& list : result.lists)
+			list.second.apply_rules(*program, file, result.rules, end, result.num_filtered, result.num_added, result.num_replaced);
+		result.rules = end;
+		if (end < rules.size())
+			s_test.checkpoints.push_back(result);
+	}
+	double apply_ms = timer.ms();
+
+	s_test.rule_hashes.clear();
+	for (auto& rule : rules)
+		s_test.rule_hashes.push_back(rule.hash);
+
+	size_t num_before = 0, num_after = 0;
+	for (auto& list : s_subbsp_mapents)
+		num_before += list.second.get_entlist().size();
+	for (auto& list : result.lists)
+		num_after += list.second.get_entlist().size();
+
+	QMM_WRITEQMMLOG(QMMLOG_NOTICE, "stripper_test: %s: ran %d of %d rules in %.3f ms (load %.3f ms)\n", file.c_str(), (int)(rules.size() - start), (int)rules.size(), apply_ms, load_ms);
+	QMM_WRITEQMMLOG(QMMLOG_NOTICE, "stripper_test: Removed %d entities, added %d entities, and replaced %d entities (%d entities -> %d entities)\n", result.num_filtered, result.num_added, result.num_replaced, (int)num_before, (int)num_after);
+
+	if (dump) {
+		// main map first, then SubBSPs
+		std::string buf;
+		result.lists[-1].dump_to_buffer(buf);
+		for (auto& list : result.lists)
+			if (list.first != -1)
+				list.second.dump_to_buffer(buf);
+		MapEntities::write_dump(QMM_VARARGS("qmmaddons/stripper/dumps/%s_test.txt", mapname.c_str()), buf);
+	}
+}
+
+
+// write binary rule files for a config, or for the global config and every map config
+static void s_compile_configs(const std::string& file) {
+	std::vector<std::string> files;
+	if (!file.empty())
+		files.push_back(file);
+	else
+		files = s_config_files();
+
+	int num_compiled = 0;
+	for (auto& f : files) {
+		if (RuleProgram::compile_file(f))
+			num_compiled++;
+	}
+	QMM_WRITEQMMLOG(QMMLOG_NOTICE, "Compiled %d of %d config(s) into binary rule files.\n", num_compiled, (int)files.size());
+}
+
+
+// return the global config and every map config (or just the current map's config if the engine can't list files)
+static std::vector<std::string> s_config_files() {
+	std::vector<std::string> files = { "qmmaddons/stripper/global.ini" };
+#if defined(GAME_HAS_FS_GETFILELIST)
+	// names are packed into listbuf, each followed by a null
+	std::vector<char> listbuf(65536);
+	int count = (int)g_syscall(G_FS_GETFILELIST, "qmmaddons/stripper/maps", ".ini", listbuf.data(), (int)listbuf.size() - 1);
+
+	const char* name = listbuf.data();
+	const char* end = listbuf.data() + listbuf.size();
+	for (int i = 0; i < count && name < end && *name; i++) {
+		files.push_back(QMM_VARARGS("qmmaddons/stripper/maps/%s", name));
+		name += strlen(name) + 1;
+	}
+#else
+	if (!mapname.empty())
+		files.push_back(QMM_VARARGS("qmmaddons/stripper/maps/%s.ini", mapname.c_str()));
+#endif
+	return files;
+}
+
+
+#if defined(GAME_HAS_FS_GETFILELIST)
+// find all map configs and start compiling them (and the global config) in the background. the files are read here
+// since the engine can only be used from this thread
+static void s_precompile_configs() {
+	std::vector<std::string> files = s_config_files();
+
+	StatTimer timer;
+	RuleProgram::precompile(files);
+	stats_time("read configs for precompile", timer.ms());
+
+	s_precompiling = RuleProgram::poll_precompile();
+}
+#endif
+
+
+// return name for a stat, separating SubBSP stats from main map stats
+static const char* s_stat_name(const char* name) {
+	if (s_subbsp_index < 0)
+		return name;
+	return QMM_VARARGS("SubBSP %s", name);
+}
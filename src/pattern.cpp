@@ -0,0 +1,921 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+#include <cctype>
+#include <cstring>
+#include <vector>
+#include <map>
+#include <string>
+#include <string_view>
+#include <regex>
+#include <bitset>
+#include <algorithm>
+
+#include "pattern.h"
+
+// limits before falling back to a slower method
+static const int s_max_repeat = 100;        // largest count in a {n,m} repeat
+static const size_t s_max_nfa = 4096;       // max NFA states
+static const size_t s_max_dfa = 512;        // max DFA states (otherwise NFA is simulated)
+
+typedef std::bitset<256> CharSet;
+
+
+// node of a parsed pattern
+struct PatternNode {
+	enum Type {
+		node_set,       // 1 char from set
+		node_concat,    // all kids in order
+		node_alt,       // any 1 kid
+		node_repeat,    // kid repeated min to max times (max = -1 for no limit)
+	};
+
+	Type type;
+	CharSet set;
+	std::vector<int> kids;
+	int min = 0;
+	int max = 0;
+};
+
+
+// parses the subset of ECMAScript regex syntax that can be compiled to an NFA. parse() returns false if the
+// pattern uses anything else (or anything that may be invalid), and the pattern should be given to std::regex
+class PatternParser {
+	public:
+		std::vector<PatternNode> nodes;
+
+		PatternParser(std::string_view src) : src(src) { }
+
+		// parse entire pattern, returns root node or -1 if unsupported
+		int parse() {
+			int root = this->parse_alt();
+			if (root < 0 || this->pos != this->src.size())
+				return -1;
+			return root;
+		}
+
+	private:
+		std::string_view src;
+		size_t pos = 0;
+
+		int add(PatternNode node) {
+			this->nodes.push_back(std::move(node));
+			return (int)this->nodes.size() - 1;
+		}
+
+		int add_set(const CharSet& set) {
+			PatternNode node;
+			node.type = PatternNode::node_set;
+			node.set = set;
+			return this->add(std::move(node));
+		}
+
+		bool at_end() const { return this->pos >= this->src.size(); }
+		char peek() const { return this->src[this->pos]; }
+
+		// alt := concat ('|' concat)*
+		int parse_alt() {
+			PatternNode alt;
+			alt.type = PatternNode::node_alt;
+
+			while (true) {
+				int concat = this->parse_concat();
+				// empty alternatives are left to std::regex
+				if (concat < 0)
+					return -1;
+				alt.kids.push_back(concat);
+
+				if (this->at_end() || this->peek() != '|')
+					break;
+				this->pos++;
+			}
+
+			if (alt.kids.size() == 1)
+				return alt.kids[0];
+			return this->add(std::move(alt));
+		}
+
+		// concat := (atom quantifier?)+
+		int parse_concat() {
+			PatternNode concat;
+			concat.type = PatternNode::node_concat;
+
+			while (!this->at_end() && this->peek() != '|' && this->peek() != ')') {
+				int atom = this->parse_atom();
+				if (atom < 0)
+					return -1;
+				atom = this->parse_quantifier(atom);
+				if (atom < 0)
+					return -1;
+				concat.kids.push_back(atom);
+			}
+
+			if (concat.kids.empty())
+				return -1;
+			if (concat.kids.size() == 1)
+				return concat.kids[0];
+			return this->add(std::move(concat));
+		}
+
+		int parse_atom() {
+			char c = this->peek();
+			this->pos++;
+
+			switch (c) {
+				// any char except line terminators
+				case '.': {
+					CharSet set;
+					set.set();
+					set.reset('\n');
+					set.reset('\r');
+					return this->add_set(set);
+				}
+				case '[':
+					return this->parse_class();
+				case '(': {
+					// only plain and non-capturing groups (captures don't matter for a yes/no match)
+					if (this->src.substr(this->pos, 2) == "?:")
+						this->pos += 2;
+					else if (!this->at_end() && this->peek() == '?')
+						return -1;
+					int group = this->parse_alt();
+					if (group < 0 || this->at_end() || this->peek() != ')')
+						return -1;
+					this->pos++;
+					return group;
+				}
+				case '\\': {
+					CharSet set;
+					if (!this->parse_escape(set, false))
+						return -1;
+					return this->add_set(set);
+				}
+				// anchors, quantifiers without an atom, and stray brackets
+				case '^': case '$': case '*': case '+': case '?': case '{': case '}': case ']': case ')': case '|':
+					return -1;
+				default: {
+					// only plain printable ASCII
+					if (c < ' ' || c > '~')
+						return -1;
+					CharSet set;
+					set.set((unsigned char)c);
+					return this->add_set(set);
+				}
+			}
+		}
+
+		// parse an escape after '\'. class escapes (\d etc) are only allowed to be negated outside of brackets
+		bool parse_escape(CharSet& set, bool in_class) {
+			if (this->at_end())
+				return false;
+			char c = this->peek();
+			this->pos++;
+
+			switch (c) {
+				case 'd': case 'D':
+					for (int i = '0'; i <= '9'; i++)
+						set.set(i);
+					break;
+				case 'w': case 'W':
+					for (int i = 'a'; i <= 'z'; i++)
+						set.set(i);
+					for (int i = 'A'; i <= 'Z'; i++)
+						set.set(i);
+					for (int i = '0'; i <= '9'; i++)
+						set.set(i);
+					set.set('_');
+					break;
+				case 's': case 'S':
+					for (char space : std::string_view(" \t\n\v\f\r"))
+						set.set((unsigned char)space);
+					break;
+				case 'n': set.set('\n'); return true;
+				case 't': set.set('\t'); return true;
+				case 'r': set.set('\r'); return true;
+				case 'f': set.set('\f'); return true;
+				case 'v': set.set('\v'); return true;
+				default:
+					// other letters and digits are special (\b, \1, \x, \u, etc), escaped punctuation is itself
+					if (c < '!' || c > '~' || isalnum((unsigned char)c))
+						return false;
+					set.set((unsigned char)c);
+					return true;
+			}
+
+			if (c == 'D' || c == 'W' || c == 'S') {
+				if (in_class)
+					return false;
+				set.flip();
+			}
+			return true;
+		}
+
+		// parse a bracket expression after '['
+		int parse_class() {
+			CharSet set;
+			bool negate = false;
+			if (!this->at_end() && this->peek() == '^') {
+				negate = true;
+				this->pos++;
+			}
+
+			// stray '-' and ']' at the beginning, and empty classes, are left to std::regex
+			if (this->at_end() || this->peek() == ']' || this->peek() == '-')
+				return -1;
+
+			while (true) {
+				if (this->at_end())
+					return -1;
+				char c = this->peek();
+				if (c == ']') {
+					this->pos++;
+					break;
+				}
+
+				// first char of a possible range (-1 for a class escape like \d)
+				int first = 0;
+				if (!this->parse_class_char(set, first))
+					return -1;
+
+				// range
+				if (!this->at_end() && this->peek() == '-') {
+					this->pos++;
+					// '-' at the end is left to std::regex
+					if (this->at_end() || this->peek() == ']' || first < 0)
+						return -1;
+					int last = 0;
+					CharSet unused;
+					if (!this->parse_class_char(unused, last) || last < 0 || last < first)
+						return -1;
+					for (int i = first; i <= last; i++)
+						set.set(i);
+				}
+				else if (first >= 0) {
+					set.set(first);
+				}
+			}
+
+			if (negate)
+				set.flip();
+			return this->add_set(set);
+		}
+
+		// parse a single char inside brackets. first is set to the char, or -1 if it was a class escape (which is
+		// added to set)
+		bool parse_class_char(CharSet& set, int& first) {
+			char c = this->peek();
+			this->pos++;
+
+			if (c == '\\') {
+				CharSet escape;
+				if (!this->parse_escape(escape, true))
+					return false;
+				// single char escape
+				if (escape.count() == 1) {
+					for (first = 0; !escape.test(first); first++)
+						;
+					return true;
+				}
+				set |= escape;
+				first = -1;
+				return true;
+			}
+
+			// nested brackets ([:alpha:] etc), '-' outside of a range, and non-ASCII
+			if (c == '[' || c == '-' || c < ' ' || c > '~')
+				return false;
+
+			first = (unsigned char)c;
+			return true;
+		}
+
+		// parse an optional quantifier after an atom. returns the atom, a new repeat node, or -1 if unsupported
+		int parse_quantifier(int atom) {
+			if (this->at_end())
+				return atom;
+
+			int min, max;
+			char c = this->peek();
+			if (c == '*') {
+				min = 0;
+				max = -1;
+				this->pos++;
+			}
+			else if (c == '+') {
+				min = 1;
+				max = -1;
+				this->pos++;
+			}
+			else if (c == '?') {
+				min = 0;
+				max = 1;
+				this->pos++;
+			}
+			else if (c == '{') {
+				this->pos++;
+				if (!this->parse_number(min))
+					return -1;
+				max = min;
+				if (!this->at_end() && this->peek() == ',') {
+					this->pos++;
+					max = -1;
+					if (!this->at_end() && this->peek() != '}' && !this->parse_number(max))
+						return -1;
+				}
+				if (this->at_end() || this->peek() != '}')
+					return -1;
+				this->pos++;
+				if (max >= 0 && max < min)
+					return -1;
+			}
+			else {
+				return atom;
+			}
+
+			// lazy quantifiers match the same strings when the whole string has to match
+			if (!this->at_end() && this->peek() == '?')
+				this->pos++;
+
+			// a quantifier can't follow another quantifier
+			if (!this->at_end() && (this->peek() == '*' || this->peek() == '+' || this->peek() == '?' || this->peek() == '{'))
+				return -1;
+
+			PatternNode repeat;
+			repeat.type = PatternNode::node_repeat;
+			repeat.kids.push_back(atom);
+			repeat.min = min;
+			repeat.max = max;
+			return this->add(std::move(repeat));
+		}
+
+		bool parse_number(int& num) {
+			size_t start = this->pos;
+			num = 0;
+			while (!this->at_end() && isdigit((unsigned char)this->peek())) {
+				num = num * 10 + (this->peek() - '0');
+				if (num > s_max_repeat)
+					return false;
+				this->pos++;
+			}
+			return this->pos > start;
+		}
+};
+
+
+// builds NFA states from parsed nodes. states are generated backwards from the end of the pattern, so each
+// node is given the state to go to after it matches
+class NfaBuilder {
+	public:
+		std::vector<CharSet>& sets;
+		std::vector<NfaState>& nfa;
+		const std::vector<PatternNode>& nodes;
+		bool too_big = false;
+
+		NfaBuilder(std::vector<CharSet>& sets, std::vector<NfaState>& nfa, const std::vector<PatternNode>& nodes)
+			: sets(sets), nfa(nfa), nodes(nodes) { }
+
+		// generate states for a node, returns its first state
+		int gen(int node, int next) {
+			if (this->nfa.size() > s_max_nfa) {
+				this->too_big = true;
+				return next;
+			}
+
+			const PatternNode& n = this->nodes[node];
+			switch (n.type) {
+				case PatternNode::node_set:
+					return this->add(NfaState::nfa_set, this->add_set(n.set), next, -1);
+				case PatternNode::node_concat:
+					for (size_t i = n.kids.size(); i > 0; i--)
+						next = this->gen(n.kids[i - 1], next);
+					return next;
+				case PatternNode::node_alt: {
+					int start = this->gen(n.kids.back(), next);
+					for (size_t i = n.kids.size() - 1; i > 0; i--)
+						start = this->add(NfaState::nfa_split, -1, this->gen(n.kids[i - 1], next), start);
+					return start;
+				}
+				case PatternNode::node_repeat: {
+					int cur = next;
+					// unlimited: loop back to a split that can either match kid again or leave
+					if (n.max < 0) {
+						int loop = this->add(NfaState::nfa_split, -1, -1, next);
+						this->nfa[loop].out = this->gen(n.kids[0], loop);
+						cur = loop;
+					}
+					// optional matches, any of which can skip to the end
+					else {
+						for (int i = n.min; i < n.max; i++)
+							cur = this->add(NfaState::nfa_split, -1, this->gen(n.kids[0], cur), next);
+					}
+					// required matches
+					for (int i = 0; i < n.min; i++)
+						cur = this->gen(n.kids[0], cur);
+					return cur;
+				}
+			}
+			return next;
+		}
+
+	private:
+		int add(NfaState::Type type, int set, int out, int out1) {
+			this->nfa.push_back({ type, set, out, out1 });
+			return (int)this->nfa.size() - 1;
+		}
+
+		int add_set(const CharSet& set) {
+			for (size_t i = 0; i < this->sets.size(); i++)
+				if (this->sets[i] == set)
+					return (int)i;
+			this->sets.push_back(set);
+			return (int)this->sets.size() - 1;
+		}
+};
+
+
+// add state and all states reachable from it without consuming a char to list. mark is used to skip states
+// already in the list
+static void s_add_state(const std::vector<NfaState>& nfa, int state, std::vector<int>& list, std::vector<int>& mark, int gen) {
+	if (mark[state] == gen)
+		return;
+	mark[state] = gen;
+	if (nfa[state].type == NfaState::nfa_split) {
+		s_add_state(nfa, nfa[state].out, list, mark, gen);
+		s_add_state(nfa, nfa[state].out1, list, mark, gen);
+		return;
+	}
+	list.push_back(state);
+}
+
+
+// compile a pattern. returns false and sets error if the pattern is invalid
+bool Pattern::compile(const std::string& pattern, std::string& error) {
+	*this = Pattern();
+
+	PatternParser parser(pattern);
+	int root = parser.parse();
+
+	// unsupported, use std::regex (which also reports any errors)
+	if (root < 0) {
+		try {
+			this->regex = std::regex(pattern);
+		}
+		catch (std::regex_error& e) {
+			error = e.what();
+			return false;
+		}
+		this->kind = kind_regex;
+		return true;
+	}
+
+	// check for plain strings joined by ".*"
+	const std::vector<PatternNode>& nodes = parser.nodes;
+	CharSet dot;
+	dot.set();
+	dot.reset('\n');
+	dot.reset('\r');
+
+	std::vector<int> seq;
+	if (nodes[root].type == PatternNode::node_concat)
+		seq = nodes[root].kids;
+	else
+		seq.push_back(root);
+
+	bool simple = true;
+	bool has_star = false;
+	std::vector<std::string> parts(1);
+	for (size_t i = 0; i < seq.size() && simple; i++) {
+		const PatternNode& node = nodes[seq[i]];
+		if (node.type == PatternNode::node_set && node.set.count() == 1) {
+			int c = 0;
+			while (!node.set.test(c))
+				c++;
+			parts.back() += (char)c;
+		}
+		else if (node.type == PatternNode::node_repeat && node.min == 0 && node.max < 0 && nodes[node.kids[0]].type == PatternNode::node_set && nodes[node.kids[0]].set == dot) {
+			has_star = true;
+			if (!parts.back().empty())
+				parts.emplace_back();
+			else if (parts.size() == 1)
+				this->glob_start = true;
+		}
+		else {
+			simple = false;
+		}
+	}
+
+	if (simple && !has_star) {
+		this->kind = kind_literal;
+		this->literal = parts[0];
+		return true;
+	}
+
+	if (simple) {
+		if (parts.back().empty()) {
+			this->glob_end = true;
+			parts.pop_back();
+		}
+		// ".*" can't match newlines, so only use plain string checks if the parts don't have any either
+		bool newline = false;
+		for (auto& part : parts)
+			if (part.find_first_of("\r\n") != std::string::npos)
+				newline = true;
+		if (!newline) {
+			this->kind = kind_glob;
+			this->parts = std::move(parts);
+			return true;
+		}
+	}
+
+	// build NFA
+	NfaBuilder builder(this->sets, this->nfa, nodes);
+	this->nfa.push_back({ NfaState::nfa_match, -1, -1, -1 });
+	this->nfa_start = builder.gen(root, 0);
+
+	// too big, use std::regex
+	if (builder.too_big) {
+		this->nfa.clear();
+		this->sets.clear();
+		// std::regex can also reject a valid pattern that is too complex
+		try {
+			this->regex = std::regex(pattern);
+		}
+		catch (std::regex_error& e) {
+			error = e.what();
+			return false;
+		}
+		this->kind = kind_regex;
+		return true;
+	}
+
+	this->kind = this->build_dfa() ? kind_dfa : kind_nfa;
+	return true;
+}
+
+
+// returns true if all of str matches the pattern
+bool Pattern::match(std::string_view str) const {
+	switch (this->kind) {
+		case kind_literal:
+			return str == this->literal;
+		case kind_glob:
+			return this->match_glob(str);
+		case kind_dfa: {
+			int state = this->dfa_start;
+			for (unsigned char c : str) {
+				state = this->table[state * this->num_classes + this->classes[c]];
+				if (!state)
+					return false;
+			}
+			return this->accept[state];
+		}
+		case kind_nfa:
+			return this->match_nfa(str);
+		case kind_regex:
+			return std::regex_match(str.begin(), str.end(), this->regex);
+	}
+	return false;
+}
+
+
+// match plain strings joined by ".*"
+bool Pattern::match_glob(std::string_view str) const {
+	// ".*" doesn't match newlines and none of the parts have them
+	if (str.find_first_of("\r\n") != std::string_view::npos)
+		return false;
+
+	size_t first = 0;
+	size_t last = this->parts.size();
+
+	// first part must be at the beginning
+	if (!this->glob_start) {
+		if (str.substr(0, this->parts[0].size()) != this->parts[0])
+			return false;
+		str.remove_prefix(this->parts[0].size());
+		first++;
+	}
+	// last part must be at the end
+	if (!this->glob_end && last > first) {
+		const std::string& part = this->parts[last - 1];
+		if (str.size() < part.size() || str.substr(str.size() - part.size()) != part)
+			return false;
+		str.remove_suffix(part.size());
+		last--;
+	}
+
+	// the rest just need to be found in order. taking the earliest match of each leaves the most room for the rest
+	for (size_t i = first; i < last; i++) {
+		size_t found = str.find(this->parts[i]);
+		if (found == std::string_view::npos)
+			return false;
+		str.remove_prefix(found + this->parts[i].size());
+	}
+
+	return true;
+}
+
+
+// simulate NFA, tracking all states that can be reached after each char
+bool Pattern::match_nfa(std::string_view str) const {
+	std::vector<int> cur, next;
+	std::vector<int> mark(this->nfa.size(), -1);
+	int gen = 0;
+
+	s_add_state(this->nfa, this->nfa_start, cur, mark, gen);
+
+	for (unsigned char c : str) {
+		next.clear();
+		gen++;
+		for (int state : cur) {
+			const NfaState& s = this->nfa[state];
+			if (s.type == NfaState::nfa_set && this->sets[s.set].test(c))
+				s_add_state(this->nfa, s.out, next, mark, gen);
+		}
+		if (next.empty())
+			return false;
+		cur.swap(next);
+	}
+
+	for (int state : cur)
+		if (this->nfa[state].type == NfaState::nfa_match)
+			return true;
+	return false;
+}
+
+
+// build DFA from nfa, returns false if it has too many states
+bool Pattern::build_dfa() {
+	// group bytes that are in exactly the same sets into classes
+	std::map<std::vector<bool>, int> signatures;
+	std::vector<int> representative;
+	for (int c = 0; c < 256; c++) {
+		std::vector<bool> signature;
+		for (auto& set : this->sets)
+			signature.push_back(set.test(c));
+		auto iter = signatures.find(signature);
+		if (iter == signatures.end()) {
+			iter = signatures.emplace(signature, (int)representative.size()).first;
+			representative.push_back(c);
+		}
+		this->classes[c] = (uint8_t)iter->second;
+	}
+	this->num_classes = (int)representative.size();
+
+	// each DFA state is a sorted list of NFA states. state 0 is the dead state (no NFA states)
+	std::map<std::vector<int>, int> ids;
+	std::vector<std::vector<int>> states;
+	std::vector<int> mark(this->nfa.size(), -1);
+	int gen = 0;
+
+	auto get_id = [&](std::vector<int>& list) {
+		std::sort(list.begin(), list.end());
+		auto iter = ids.find(list);
+		if (iter != ids.end())
+			return iter->second;
+		int id = (int)states.size();
+		ids.emplace(list, id);
+		states.push_back(list);
+		return id;
+	};
+
+	std::vector<int> list;
+	get_id(list);
+	s_add_state(this->nfa, this->nfa_start, list, mark, gen);
+	this->dfa_start = get_id(list);
+
+	// states are added to the end while working through the list
+	for (size_t i = 0; i < states.size(); i++) {
+		if (states.size() > s_max_dfa) {
+			this->table.clear();
+			this->accept.clear();
+			return false;
+		}
+
+		bool accepts = false;
+		for (int state : states[i])
+			if (this->nfa[state].type == NfaState::nfa_match)
+				accepts = true;
+		this->accept.push_back(accepts);
+
+		for (int cls = 0; cls < this->num_classes; cls++) {
+			list.clear();
+			gen++;
+			for (int state : states[i]) {
+				const NfaState& s = this->nfa[state];
+				if (s.type == NfaState::nfa_set && this->sets[s.set].test(representative[cls]))
+					s_add_state(this->nfa, s.out, list, mark, gen);
+			}
+			// careful: get_id can add to states
+			int next = get_id(list);
+			this->table.push_back(next);
+		}
+	}
+
+	return true;
+}
+
+
+// fixed-size values are stored in native byte order, since the binary rule file is checked for that as a whole
+template <typename T>
+static void s_put(std::string& buf, T val) {
+	buf.append((const char*)&val, sizeof(val));
+}
+
+
+static void s_put_str(std::string& buf, const std::string& str) {
+	s_put(buf, (uint32_t)str.size());
+	buf.append(str);
+}
+
+
+// read a value written by s_put, returns false if data is too short
+template <typename T>
+static bool s_get(std::string_view& data, T& val) {
+	if (data.size() < sizeof(val))
+		return false;
+	memcpy(&val, data.data(), sizeof(val));
+	data.remove_prefix(sizeof(val));
+	return true;
+}
+
+
+static bool s_get_str(std::string_view& data, std::string& str) {
+	uint32_t size;
+	if (!s_get(data, size) || data.size() < size)
+		return false;
+	str.assign(data.data(), size);
+	data.remove_prefix(size);
+	return true;
+}
+
+
+// append the compiled pattern to buf. only what match() uses for the pattern's kind is stored
+void Pattern::save(std::string& buf) const {
+	s_put(buf, (uint8_t)this->kind);
+	switch (this->kind) {
+		case kind_literal:
+			s_put_str(buf, this->literal);
+			break;
+		case kind_glob:
+			s_put(buf, (uint8_t)this->glob_start);
+			s_put(buf, (uint8_t)this->glob_end);
+			s_put(buf, (uint32_t)this->parts.size());
+			for (auto& part : this->parts)
+				s_put_str(buf, part);
+			break;
+		case kind_dfa:
+			buf.append((const char*)this->classes, sizeof(this->classes));
+			s_put(buf, (int32_t)this->num_classes);
+			s_put(buf, (int32_t)this->dfa_start);
+			s_put(buf, (uint32_t)this->accept.size());
+			for (bool accept : this->accept)
+				s_put(buf, (uint8_t)accept);
+			for (int next : this->table)
+				s_put(buf, (int32_t)next);
+			break;
+		case kind_nfa:
+			s_put(buf, (uint32_t)this->sets.size());
+			for (auto& set : this->sets) {
+				uint8_t bytes[32] = {};
+				for (int c = 0; c < 256; c++)
+					if (set.test(c))
+						bytes[c / 8] |= 1 << (c % 8);
+				buf.append((const char*)bytes, sizeof(bytes));
+			}
+			s_put(buf, (uint32_t)this->nfa.size());
+			for (auto& state : this->nfa) {
+				s_put(buf, (uint8_t)state.type);
+				s_put(buf, (int32_t)state.set);
+				s_put(buf, (int32_t)state.out);
+				s_put(buf, (int32_t)state.out1);
+			}
+			s_put(buf, (int32_t)this->nfa_start);
+			break;
+		case kind_regex:
+			// compiled again from the source
+			break;
+	}
+}
+
+
+// load a pattern written by save(). every index is checked, so a damaged file can't make match() read out of bounds
+bool Pattern::load(std::string_view& data, const std::string& source, std::string& error) {
+	*this = Pattern();
+	error = "invalid compiled pattern";
+
+	uint8_t kind;
+	if (!s_get(data, kind))
+		return false;
+
+	switch (kind) {
+		case kind_literal:
+			if (!s_get_str(data, this->literal))
+				return false;
+			break;
+		case kind_glob: {
+			uint8_t start, end;
+			uint32_t count;
+			if (!s_get(data, start) || !s_get(data, end) || !s_get(data, count))
+				return false;
+			this->glob_start = start;
+			this->glob_end = end;
+			for (uint32_t i = 0; i < count; i++) {
+				std::string part;
+				if (!s_get_str(data, part))
+					return false;
+				this->parts.push_back(std::move(part));
+			}
+			break;
+		}
+		case kind_dfa: {
+			int32_t num_classes, start;
+			uint32_t num_states;
+			if (data.size() < sizeof(this->classes))
+				return false;
+			memcpy(this->classes, data.data(), sizeof(this->classes));
+			data.remove_prefix(sizeof(this->classes));
+			if (!s_get(data, num_classes) || !s_get(data, start) || !s_get(data, num_states))
+				return false;
+			if (num_classes <= 0 || num_classes > 256 || num_states == 0 || num_states > s_max_dfa || start < 0 || (uint32_t)start >= num_states)
+				return false;
+			for (int c = 0; c < 256; c++)
+				if (this->classes[c] >= num_classes)
+					return false;
+			this->num_classes = num_classes;
+			this->dfa_start = start;
+			for (uint32_t i = 0; i < num_states; i++) {
+				uint8_t accept;
+				if (!s_get(data, accept))
+					return false;
+				this->accept.push_back(accept != 0);
+			}
+			if (data.size() / sizeof(int32_t) < (size_t)num_states * num_classes)
+				return false;
+			this->table.resize((size_t)num_states * num_classes);
+			for (auto& next : this->table) {
+				int32_t state;
+				if (!s_get(data, state) || state < 0 || (uint32_t)state >= num_states)
+					return false;
+				next = state;
+			}
+			break;
+		}
+		case kind_nfa: {
+			uint32_t num_sets, num_states;
+			int32_t start;
+			if (!s_get(data, num_sets) || data.size() / 32 < num_sets)
+				return false;
+			for (uint32_t i = 0; i < num_sets; i++) {
+				CharSet set;
+				for (int c = 0; c < 256; c++)
+					if ((uint8_t)data[c / 8] & (1 << (c % 8)))
+						set.set(c);
+				data.remove_prefix(32);
+				this->sets.push_back(set);
+			}
+			if (!s_get(data, num_states) || num_states == 0)
+				return false;
+			auto valid = [num_states](int32_t state) { return state >= 0 && (uint32_t)state < num_states; };
+			for (uint32_t i = 0; i < num_states; i++) {
+				uint8_t type;
+				int32_t set, out, out1;
+				if (!s_get(data, type) || !s_get(data, set) || !s_get(data, out) || !s_get(data, out1))
+					return false;
+				if (type == NfaState::nfa_set && (set < 0 || (uint32_t)set >= num_sets || !valid(out)))
+					return false;
+				if (type == NfaState::nfa_split && (!valid(out) || !valid(out1)))
+					return false;
+				if (type > NfaState::nfa_match)
+					return false;
+				this->nfa.push_back({ (NfaState::Type)type, set, out, out1 });
+			}
+			if (!s_get(data, start) || !valid(start))
+				return false;
+			this->nfa_start = start;
+			break;
+		}
+		case kind_regex:
+			try {
+				this->regex = std::regex(source);
+			}
+			catch (std::regex_error& e) {
+				error = e.what();
+				return false;
+			}
+			break;
+		default:
+			return false;
+	}
+
+	this->kind = (Kind)kind;
+	error.clear();
+	return true;
+}
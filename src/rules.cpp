@@ -0,0 +1,1051 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+#include "version.h"
+#include <qmmapi.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <chrono>
+#include <future>
+#include <functional>
+#include <algorithm>
+
+#include "game.h"
+#include "ent.h"
+#include "pattern.h"
+#include "rules.h"
+#include "strpool.h"
+#include "tokenizer.h"
+#include "util.h"
+
+
+// compile a mask entity. returns false and sets error if a regex failed to compile
+bool Matcher::compile(const KeyValViews& mask, std::string& error) {
+	this->preds.clear();
+	this->preds.reserve(mask.size());
+
+	for (auto& keyval : mask) {
+		std::string_view matchkey = keyval.first;
+		std::string_view matchval = keyval.second;
+
+		Predicate pred;
+		pred.key = matchkey;
+
+		// an empty matchval means the ent should NOT have the matchkey
+		if (matchval.empty()) {
+			pred.type = Predicate::pred_absent;
+		}
+		// check matchval for leading and trailing "/" to do a regex match
+		else if (matchval[0] == '/' && matchval[matchval.size() - 1] == '/') {
+			pred.type = Predicate::pred_regex;
+			// generate a regex pattern using the matchval with leading and trailing "/" removed
+			pred.val = matchval.substr(1, matchval.size() - 2);
+			if (!pred.regex.compile(pred.val, error)) {
+				this->preds.clear();
+				return false;
+			}
+			// a regex with no special chars is just an exact match (which can also use the key indexes)
+			if (pred.regex.is_literal()) {
+				pred.type = Predicate::pred_exact;
+				pred.val = pred.regex.get_literal();
+				pred.regex = Pattern();
+			}
+		}
+		else {
+			pred.type = Predicate::pred_exact;
+			pred.val = matchval;
+		}
+
+		this->preds.push_back(std::move(pred));
+	}
+
+	// test cheap predicates first so most entities are rejected before reaching a regex. masks only have a few
+	// predicates (usually already in order), so a stable insertion sort is cheapest
+	for (size_t i = 1; i < this->preds.size(); i++) {
+		for (size_t j = i; j > 0 && this->preds[j].type < this->preds[j - 1].type; j--)
+			std::swap(this->preds[j], this->preds[j - 1]);
+	}
+
+	return true;
+}
+
+
+// add a predicate that was already compiled and sorted by compile()
+void Matcher::add(Predicate pred) {
+	this->preds.push_back(std::move(pred));
+}
+
+
+// resolve keys and vals to ids in pool. the Matcher must outlive the returned BoundMatcher
+BoundMatcher Matcher::bind(const StringPool& pool) const {
+	BoundMatcher bound;
+
+	for (auto& pred : this->preds) {
+		StrId key = pool.find(pred.key);
+
+		// key isn't used by any entity
+		if (key == str_none) {
+			// absent key always passes, so the predicate can be dropped
+			if (pred.type == Predicate::pred_absent)
+				continue;
+			// otherwise nothing can match
+			bound.never = true;
+			break;
+		}
+
+		StrId val = str_none;
+		if (pred.type == Predicate::pred_exact) {
+			val = pool.find(pred.val);
+			// val isn't used by any entity, nothing can match
+			if (val == str_none) {
+				bound.never = true;
+				break;
+			}
+		}
+
+		bound.preds.push_back({ pred.type, key, val, &pred.regex });
+	}
+
+	return bound;
+}
+
+
+// returns true if ent passes a single predicate
+static inline bool s_test(const BoundPredicate& pred, const Ent& ent, const StringPool& pool) {
+	// look up key in ent
+	const StrId* val = ent.get(pred.key);
+
+	switch (pred.type) {
+		case Predicate::pred_exact:
+			return val && *val == pred.val;
+		case Predicate::pred_absent:
+			// a present key with an empty val is treated the same as a missing key
+			return !val || *val == str_empty;
+		case Predicate::pred_regex: {
+			if (!val)
+				return false;
+			std::string_view testval = pool.get(*val);
+			return pred.regex->match(testval);
+		}
+	}
+	return false;
+}
+
+
+// returns true if ent passes every predicate. a matcher with no predicates matches all entities
+bool BoundMatcher::match(const Ent& ent, const StringPool& pool) const {
+	if (this->never)
+		return false;
+
+	if (this->profile)
+		return this->match_profiled(ent, pool);
+
+	for (auto& pred : this->preds) {
+		if (!s_test(pred, ent, pool))
+			return false;
+	}
+	return true;
+}
+
+
+// match() with profiling
+bool BoundMatcher::match_profiled(const Ent& ent, const StringPool& pool) const {
+	StatTimer timer;
+	bool matched = true;
+
+	for (auto& pred : this->preds) {
+		bool passed;
+		// time regex predicates on their own
+		if (pred.type == Predicate::pred_regex) {
+			StatTimer regex_timer;
+			passed = s_test(pred, ent, pool);
+			this->profile->regex_ms += regex_timer.ms();
+			this->profile->regex_tested++;
+		}
+		else {
+			passed = s_test(pred, ent, pool);
+		}
+
+		if (!passed) {
+			matched = false;
+			break;
+		}
+	}
+
+	this->profile->tested++;
+	if (matched)
+		this->profile->matched++;
+	this->profile->ms += timer.ms();
+
+	return matched;
+}
+
+
+// tokens that have a special meaning in configs
+enum Keyword {
+	kw_none,
+	kw_filter,
+	kw_add,
+	kw_replace,
+	kw_with,
+	kw_open,        // "{"
+	kw_close,       // "}"
+};
+
+
+// classify a config token. the length and trailing ':' are checked first, so most keys and vals are rejected
+// without comparing any strings
+static inline Keyword s_keyword(std::string_view token) {
+	switch (token.size()) {
+		case 1:
+			if (token[0] == '{')
+				return kw_open;
+			if (token[0] == '}')
+				return kw_close;
+			break;
+		case 4:
+			if (token[3] == ':' && str_striequal(token, "add:"))
+				return kw_add;
+			break;
+		case 5:
+			if (token[4] == ':' && str_striequal(token, "with:"))
+				return kw_with;
+			break;
+		case 7:
+			if (token[6] == ':' && str_striequal(token, "filter:"))
+				return kw_filter;
+			break;
+		case 8:
+			if (token[7] == ':' && str_striequal(token, "replace:"))
+				return kw_replace;
+			break;
+	}
+	return kw_none;
+}
+
+
+// sort keyvals by key and remove duplicate keys, keeping the last val for each key (like assigning them to a
+// KeyValMap in order)
+static void s_sort_keyvals(KeyValViews& keyvals) {
+	// entities only have a few keyvals, so a stable insertion sort is fastest (and doesn't allocate)
+	for (size_t i = 1; i < keyvals.size(); i++) {
+		auto keyval = keyvals[i];
+		size_t j = i;
+		for (; j > 0 && keyval.first < keyvals[j - 1].first; j--)
+			keyvals[j] = keyvals[j - 1];
+		keyvals[j] = keyval;
+	}
+
+	size_t n = 0;
+	for (size_t i = 0; i < keyvals.size(); i++) {
+		if (i + 1 < keyvals.size() && keyvals[i + 1].first == keyvals[i].first)
+			continue;
+		keyvals[n++] = keyvals[i];
+	}
+	keyvals.resize(n);
+}
+
+
+// return a token that stays valid until compiling is done. tokens are views into text, except for unquoted tokens
+// with stripped chars, which are copied into stripped
+static std::string_view s_keep(std::string_view token, std::string_view text, std::deque<std::string>& stripped) {
+	if (token.data() >= text.data() && token.data() + token.size() <= text.data() + text.size())
+		return token;
+	stripped.emplace_back(token);
+	return stripped.back();
+}
+
+
+// copy sorted keyvals into a KeyValMap
+static KeyValMap s_to_map(const KeyValViews& keyvals) {
+	KeyValMap map;
+	for (auto& keyval : keyvals)
+		map.emplace_hint(map.end(), keyval.first, keyval.second);
+	return map;
+}
+
+
+// add a rule type and sorted keyvals to a rule hash
+static uint64_t s_hash_keyvals(char type, const KeyValViews& keyvals, uint64_t hash) {
+	hash = hash_fnv1a(std::string_view(&type, 1), hash);
+	for (auto& keyval : keyvals) {
+		// include the null terminators so "ab" "c" and "a" "bc" hash differently
+		hash = hash_fnv1a(keyval.first, hash);
+		hash = hash_fnv1a(std::string_view("", 1), hash);
+		hash = hash_fnv1a(keyval.second, hash);
+		hash = hash_fnv1a(std::string_view("", 1), hash);
+	}
+	return hash;
+}
+
+
+// compile config text into rules
+void RuleProgram::compile(std::string_view text) {
+	// check for '=' to warn that it likely won't load
+	if (text.find('=') != std::string_view::npos)
+		this->warn("Possible old config format detected, likely will fail to load.\n");
+
+	// tokenize it
+	Tokenizer tokens(text);
+	std::string_view token;
+
+	// the current ent we are building. keyvals are views into text, and are only copied once the entity
+	// is compiled into a rule
+	KeyValViews ent;
+	// store key. when a val is received, make a new entry into ent
+	std::string_view key;
+	// unquoted tokens with stripped chars aren't views into text, and are only valid until the next token,
+	// so copies are kept here until compiling is done
+	std::deque<std::string> stripped;
+
+	// this stores compiled masks for entities that should be replaced
+	// nodes are read and removed from this list when a "with" entity is found
+	std::vector<Matcher> replace_list;
+	// hash of the masks in replace_list, for the "with" rule that uses them
+	uint64_t replace_hash = hash_fnv1a({});
+	// compiled mask for the current "filter" or "replace" entity
+	Matcher matcher;
+	std::string error;
+
+	// line of the current entity's opening brace. lines are counted up to each opening brace as it is found
+	int line = 1;
+	size_t line_pos = 0;
+
+	// what the current entity mode is
+	enum Mode {
+		mode_filter,
+		mode_add,
+		mode_replace,
+		mode_with,
+	} mode = mode_filter;
+
+	bool inside_ent = false;	// false = between ents, true = inside an ent
+	bool is_key = true;			// true = expecting key, false = expecting val 
+
+	// go through every token
+	while (tokens.next(token)) {
+		Keyword keyword = s_keyword(token);
+
+		// if not inside an entity, we can either start a new entity or switch modes
+		if (!inside_ent) {
+			// look for mode tokens
+			if (keyword == kw_filter) {
+				mode = mode_filter;
+			}
+			else if (keyword == kw_add) {
+				mode = mode_add;
+			}
+			else if (keyword == kw_replace) {
+				mode = mode_replace;
+			}
+			else if (keyword == kw_with) {
+				mode = mode_with;
+			}
+
+			// valid opening brace, make a new entity
+			else if (keyword == kw_open) {
+				inside_ent = true;
+				is_key = true;
+				ent.clear();
+
+				// braces are always views into text
+				size_t pos = token.data() - text.data();
+				line += (int)std::count(text.begin() + line_pos, text.begin() + pos, '\n');
+				line_pos = pos;
+			}
+
+			// unknown token
+			else {
+				this->warn("Unexpected token \"%.*s\", expected \"filter:\", \"add:\", \"replace:\", \"with:\", or \"{\"; ignoring.\n", (int)token.size(), token.data());
+			}
+		}
+		// inside an entity. we can either have a key, value, or end the entity
+		else {
+			// if this is a valid closing brace, handle the entity
+			if (keyword == kw_close) {
+				inside_ent = false;
+
+				// if entity ended between key and val, print warning
+				if (!is_key) {
+					this->warn("Unexpected end of entity with hanging key \"%.*s\"; ignoring.\n", (int)key.size(), key.data());
+				}
+
+				s_sort_keyvals(ent);
+
+				// filter mode, don't accept empty entity
+				if (mode == mode_filter) {
+					if (ent.empty()) {
+						this->warn("Empty \"filter\" entity found; ignoring.\n");
+					}
+					else if (!matcher.compile(ent, error)) {
+						this->warn("Invalid regex in \"filter\" entity (%s); ignoring.\n", error.c_str());
+					}
+					else {
+						this->num_filters++;
+						matcher.line = line;
+						// filters only remove entities, so running consecutive filters one after another is the
+						// same as removing entities that match any of them. merge them so they are run in one pass
+						if (this->rules.empty() || this->rules.back().type != Rule::rule_filter) {
+							Rule rule;
+							rule.type = Rule::rule_filter;
+							rule.hash = hash_fnv1a({});
+							this->rules.push_back(std::move(rule));
+						}
+						this->rules.back().filter.push_back(std::move(matcher));
+						this->rules.back().hash = s_hash_keyvals('f', ent, this->rules.back().hash);
+					}
+				}
+				// add mode, don't accept empty entity or one without a classname
+				else if (mode == mode_add) {
+					if (ent.empty()) {
+						this->warn("Empty \"add\" entity found; ignoring.\n");
+					}
+					else if (std::none_of(ent.begin(), ent.end(), [](const auto& keyval) { return keyval.first == "classname"; })) {
+						this->warn("Found \"add\" entity without \"classname\"; ignoring.\n");
+					}
+					else {
+						this->num_adds++;
+						Rule rule;
+						rule.type = Rule::rule_add;
+						rule.ent = s_to_map(ent);
+						rule.hash = s_hash_keyvals('a', ent, hash_fnv1a({}));
+						rule.line = line;
+						this->rules.push_back(std::move(rule));
+					}
+				}
+				// replace mode, accept empty entity to match all
+				else if (mode == mode_replace) {
+					if (!matcher.compile(ent, error)) {
+						this->warn("Invalid regex in \"replace\" entity (%s); ignoring.\n", error.c_str());
+					}
+					else {
+						this->num_replaces++;
+						matcher.line = line;
+						replace_list.push_back(std::move(matcher));	// store until a "with" ent comes along
+						replace_hash = s_hash_keyvals('r', ent, replace_hash);
+					}
+				}
+				// with mode, don't accept empty entity
+				else if (mode == mode_with) {
+					if (ent.empty()) {
+						this->warn("Empty \"with\" entity found; ignoring.\n");
+					}
+					else {
+						this->num_withs++;
+						Rule rule;
+						rule.type = Rule::rule_replace;
+						// "with" entry uses up all prior "replace" entities
+						rule.replace = std::move(replace_list);
+						replace_list.clear();
+						rule.ent = s_to_map(ent);
+						rule.hash = s_hash_keyvals('w', ent, replace_hash);
+						replace_hash = hash_fnv1a({});
+						rule.line = line;
+						this->rules.push_back(std::move(rule));
+					}
+				}
+			}
+
+			// look for mode tokens or opening brace
+			else if (keyword != kw_none) {
+				this->warn("Unexpected \"%.*s\" token found inside an entity; ignoring.\n", (int)token.size(), token.data());
+			}
+
+			// it's a key or val
+			else {
+				// this is a key
+				if (is_key) {
+					// if key is empty, skip it
+					if (token.empty()) {
+						this->warn("Unexpected empty token found, expected key; ignoring.\n");
+					}
+					else {
+						is_key = false;
+						key = s_keep(token, text, stripped);
+					}
+				}
+				// this is a value
+				else {
+					is_key = true;
+
+					// don't allow value to be empty in "add:" block
+					if (mode == mode_add && token.empty()) {
+						this->warn("Unexpected empty value for key \"%.*s\" found in \"add\" entity; ignoring.\n", (int)key.size(), key.data());
+					}
+					else {
+						// store keyval in ent
+						ent.emplace_back(key, s_keep(token, text, stripped));
+					}
+				}
+			}
+		}
+	}
+}
+
+
+// binary rule files are a header, a table of every string used (each stored once), the warnings, and then the rules.
+// strings are referenced by their index in the table. numbers are stored in native byte order, so a file made on a
+// machine with a different byte order (or with a different format version) is just ignored and the config is
+// compiled again
+static const char s_bin_magic[8] = { 'S', 'T', 'R', 'P', 'R', 'U', 'L', 'E' };
+static const uint32_t s_bin_version = 2;
+static const uint32_t s_bin_byte_order = 0x01020304;
+
+
+// builds the string table and rule data for a binary rule file
+struct BinWriter {
+	std::unordered_map<std::string_view, uint32_t> ids;
+	std::vector<std::string_view> strings;
+	std::string body;
+
+	template <typename T>
+	void put(T val) {
+		this->body.append((const char*)&val, sizeof(val));
+	}
+
+	// strings must stay alive until the file is written
+	void put_str(std::string_view str) {
+		auto iter = this->ids.try_emplace(str, (uint32_t)this->strings.size()).first;
+		if (iter->second == this->strings.size())
+			this->strings.push_back(str);
+		this->put(iter->second);
+	}
+
+	void put_matchers(const std::vector<Matcher>& matchers) {
+		this->put((uint32_t)matchers.size());
+		for (auto& matcher : matchers) {
+			this->put((int32_t)matcher.line);
+			this->put((uint32_t)matcher.get_preds().size());
+			for (auto& pred : matcher.get_preds()) {
+				this->put((uint8_t)pred.type);
+				this->put_str(pred.key);
+				this->put_str(pred.val);
+				// regexes are stored compiled, including whether they are really plain strings or globs
+				if (pred.type == Predicate::pred_regex)
+					pred.regex.save(this->body);
+			}
+		}
+	}
+};
+
+
+// reads a binary rule file. any read past the end sets ok to false and returns 0 or an empty string
+struct BinReader {
+	std::string_view data;
+	size_t pos = 0;
+	bool ok = true;
+	std::vector<std::string_view> strings;
+
+	template <typename T>
+	T get() {
+		T val{};
+		if (this->data.size() - this->pos < sizeof(val)) {
+			this->ok = false;
+			return val;
+		}
+		memcpy(&val, this->data.data() + this->pos, sizeof(val));
+		this->pos += sizeof(val);
+		return val;
+	}
+
+	std::string_view get_str() {
+		uint32_t id = this->get<uint32_t>();
+		if (id >= this->strings.size()) {
+			this->ok = false;
+			return {};
+		}
+		return this->strings[id];
+	}
+
+	bool get_matchers(std::vector<Matcher>& matchers) {
+		uint32_t count = this->get<uint32_t>();
+		std::string error;
+		for (uint32_t i = 0; i < count && this->ok; i++) {
+			Matcher matcher;
+			matcher.line = this->get<int32_t>();
+			uint32_t num_preds = this->get<uint32_t>();
+			for (uint32_t j = 0; j < num_preds && this->ok; j++) {
+				uint8_t type = this->get<uint8_t>();
+				Predicate pred;
+				pred.key = this->get_str();
+				pred.val = this->get_str();
+				if (!this->ok || type > Predicate::pred_regex) {
+					this->ok = false;
+					break;
+				}
+				pred.type = (Predicate::Type)type;
+				if (pred.type == Predicate::pred_regex) {
+					std::string_view rest = this->data.substr(this->pos);
+					if (!pred.regex.load(rest, pred.val, error)) {
+						this->ok = false;
+						break;
+					}
+					this->pos = this->data.size() - rest.size();
+				}
+				matcher.add(std::move(pred));
+			}
+			matchers.push_back(std::move(matcher));
+		}
+		return this->ok;
+	}
+};
+
+
+// write the compiled config to buf as a binary rule file
+void RuleProgram::save_binary(std::string& buf) const {
+	BinWriter writer;
+
+	writer.put((uint32_t)this->warnings.size());
+	for (auto& warning : this->warnings)
+		writer.put_str(warning);
+
+	writer.put((uint32_t)this->rules.size());
+	for (auto& rule : this->rules) {
+		writer.put((uint8_t)rule.type);
+		writer.put((int32_t)rule.line);
+		writer.put(rule.hash);
+		writer.put_matchers(rule.filter);
+		writer.put_matchers(rule.replace);
+		writer.put((uint32_t)rule.ent.size());
+		for (auto& keyval : rule.ent) {
+			writer.put_str(keyval.first);
+			writer.put_str(keyval.second);
+		}
+	}
+
+	buf.clear();
+	buf.append(s_bin_magic, sizeof(s_bin_magic));
+	auto put = [&buf](auto val) { buf.append((const char*)&val, sizeof(val)); };
+	put(s_bin_version);
+	put(s_bin_byte_order);
+	put(this->hash);
+	put(this->source_size);
+	put((int32_t)this->num_filters);
+	put((int32_t)this->num_adds);
+	put((int32_t)this->num_replaces);
+	put((int32_t)this->num_withs);
+	put((uint32_t)writer.strings.size());
+	for (auto& str : writer.strings) {
+		put((uint32_t)str.size());
+		buf.append(str);
+	}
+	buf.append(writer.body);
+}
+
+
+// read the start of a binary rule file up to the hash and size of the config it was made from. returns false if it
+// isn't a binary rule file, or is from a different format version or byte order
+static bool s_read_bin_header(BinReader& reader, uint64_t& hash, uint64_t& size) {
+	if (reader.data.size() < sizeof(s_bin_magic) || memcmp(reader.data.data(), s_bin_magic, sizeof(s_bin_magic)) != 0)
+		return false;
+	reader.pos = sizeof(s_bin_magic);
+	if (reader.get<uint32_t>() != s_bin_version || reader.get<uint32_t>() != s_bin_byte_order)
+		return false;
+	hash = reader.get<uint64_t>();
+	size = reader.get<uint64_t>();
+	return reader.ok;
+}
+
+
+// load a compiled config from a binary rule file made by save_binary()
+bool RuleProgram::load_binary(std::string_view data) {
+	BinReader reader;
+	reader.data = data;
+
+	if (!s_read_bin_header(reader, this->hash, this->source_size))
+		return false;
+	this->num_filters = reader.get<int32_t>();
+	this->num_adds = reader.get<int32_t>();
+	this->num_replaces = reader.get<int32_t>();
+	this->num_withs = reader.get<int32_t>();
+
+	// strings are views into data until they are copied into the rules
+	uint32_t num_strings = reader.get<uint32_t>();
+	for (uint32_t i = 0; i < num_strings && reader.ok; i++) {
+		uint32_t size = reader.get<uint32_t>();
+		if (data.size() - reader.pos < size)
+			return false;
+		reader.strings.push_back(data.substr(reader.pos, size));
+		reader.pos += size;
+	}
+
+	uint32_t num_warnings = reader.get<uint32_t>();
+	for (uint32_t i = 0; i < num_warnings && reader.ok; i++)
+		this->warnings.emplace_back(reader.get_str());
+
+	uint32_t num_rules = reader.get<uint32_t>();
+	for (uint32_t i = 0; i < num_rules && reader.ok; i++) {
+		Rule rule;
+		uint8_t type = reader.get<uint8_t>();
+		if (type > Rule::rule_replace)
+			return false;
+		rule.type = (Rule::Type)type;
+		rule.line = reader.get<int32_t>();
+		rule.hash = reader.get<uint64_t>();
+		if (!reader.get_matchers(rule.filter) || !reader.get_matchers(rule.replace))
+			return false;
+		// keyvals were written from a KeyValMap, so they are already sorted
+		uint32_t num_keyvals = reader.get<uint32_t>();
+		for (uint32_t j = 0; j < num_keyvals && reader.ok; j++) {
+			std::string_view key = reader.get_str();
+			std::string_view val = reader.get_str();
+			rule.ent.emplace_hint(rule.ent.end(), key, val);
+		}
+		this->rules.push_back(std::move(rule));
+	}
+
+	return reader.ok && reader.pos == data.size();
+}
+
+
+// return the binary rule file for a config file
+std::string RuleProgram::binary_file(const std::string& file) {
+	std::string_view ext = ".ini";
+	if (file.size() >= ext.size() && str_striequal(std::string_view(file).substr(file.size() - ext.size()), ext))
+		return file.substr(0, file.size() - ext.size()) + ".bin";
+	return file + ".bin";
+}
+
+
+// cached compiled config for a single file. the program may still be compiling in the background
+struct CachedProgram {
+	uint64_t hash = 0;
+	std::shared_future<std::shared_ptr<const RuleProgram>> program;
+	// set once the program's warnings have been logged
+	bool reported = false;
+};
+static std::map<std::string, CachedProgram> s_programs;
+
+// a config read by precompile() to be compiled in the background
+struct PrecompileJob {
+	std::string text;
+	uint64_t hash = 0;
+	std::promise<std::shared_ptr<const RuleProgram>> promise;
+};
+// background compile started by precompile()
+static std::future<void> s_precompile_task;
+// files from precompile() whose warnings haven't been logged yet
+static std::vector<std::string> s_precompile_pending;
+// configs whose binary rule file precompile() found to be out of date, even though the size matches
+static std::set<std::string> s_stale_binaries;
+
+
+// read an entire file into buf, returns false if it couldn't be opened
+static bool s_read_file(const std::string& file, std::string& buf) {
+	fileHandle_t f = 0;
+	intptr_t size = g_syscall(G_FS_FOPEN_FILE, file.c_str(), &f, FS_READ);
+	// file failed to load
+	if (size <= 0 || !f) {
+		if (f)
+			g_syscall(G_FS_FCLOSE_FILE, f);
+		return false;
+	}
+
+	buf.resize(size);
+	g_syscall(G_FS_READ, buf.data(), size, f);
+	g_syscall(G_FS_FCLOSE_FILE, f);
+	return true;
+}
+
+
+// return the size of a file without reading it, or -1 if it couldn't be opened
+static intptr_t s_file_size(const std::string& file) {
+	fileHandle_t f = 0;
+	intptr_t size = g_syscall(G_FS_FOPEN_FILE, file.c_str(), &f, FS_READ);
+	if (!f)
+		return -1;
+	g_syscall(G_FS_FCLOSE_FILE, f);
+	return size;
+}
+
+
+// compile config text (stopping at the first null, if any). if compiling fails, the config is loaded with no rules
+// and the error as its only warning, so one bad config can't stop the others from loading
+static std::shared_ptr<const RuleProgram> s_compile(const std::string& text, uint64_t hash) {
+	std::shared_ptr<RuleProgram> program = std::make_shared<RuleProgram>();
+	program->hash = hash;
+	program->source_size = text.size();
+	try {
+		program->compile(text.c_str());
+	}
+	catch (std::exception& e) {
+		program = std::make_shared<RuleProgram>();
+		program->hash = hash;
+		program->source_size = text.size();
+		program->warnings.push_back(std::string("Failed to compile config (") + e.what() + "); ignoring.\n");
+	}
+	return program;
+}
+
+
+// load a config's binary rule file, or return nullptr if it is missing, invalid, or wasn't made from the config
+// contents with the given hash. a binary rule file that is out of date is remembered, so load() won't use it either
+static std::shared_ptr<const RuleProgram> s_load_binary(const std::string& file, uint64_t hash) {
+	std::string buf;
+	if (!s_read_file(RuleProgram::binary_file(file), buf))
+		return nullptr;
+
+	std::shared_ptr<RuleProgram> program = std::make_shared<RuleProgram>();
+	if (!program->load_binary(buf) || program->hash != hash) {
+		QMM_WRITEQMMLOG(QMMLOG_DEBUG, "Binary rule file for \"%s\" is out of date, compiling config.\n", file.c_str());
+		s_stale_binaries.insert(file);
+		return nullptr;
+	}
+	QMM_WRITEQMMLOG(QMMLOG_DEBUG, "Loaded binary rule file for \"%s\".\n", file.c_str());
+	s_stale_binaries.erase(file);
+	return program;
+}
+
+
+// log the warnings from compiling a config
+static void s_log_warnings(const std::string& file, const RuleProgram& program) {
+	for (auto& warning : program.warnings)
+		QMM_WRITEQMMLOG(QMMLOG_WARNING, "%s: %s", file.c_str(), warning.c_str());
+}
+
+
+// log warnings for a background compile, if they haven't been logged yet
+static void s_report(const std::string& file, CachedProgram& cached) {
+	if (cached.reported)
+		return;
+	cached.reported = true;
+	try {
+		s_log_warnings(file, *cached.program.get());
+	}
+	catch (std::exception& e) {
+		QMM_WRITEQMMLOG(QMMLOG_WARNING, "%s: Failed to compile config (%s).\n", file.c_str(), e.what());
+	}
+}
+
+
+// load a config file, or nullptr if the file couldn't be read. if lookup is set, it is given the contents' hash
+// first, and a program it returns is used instead
+static std::shared_ptr<const RuleProgram> s_load_file(const std::string& file, const std::function<std::shared_ptr<const RuleProgram>(uint64_t)>& lookup) {
+	std::shared_ptr<const RuleProgram> program;
+
+	// a binary rule file is used while the config still has the size it was compiled from, so loading it takes a
+	// single read and the config itself is only opened to get its size. precompile() checks the whole contents
+	if (!s_stale_binaries.count(file)) {
+		std::string bin;
+		if (s_read_file(RuleProgram::binary_file(file), bin)) {
+			intptr_t size = s_file_size(file);
+			if (size <= 0)
+				return nullptr;
+
+			BinReader reader;
+			reader.data = bin;
+			uint64_t hash, binsize;
+			if (s_read_bin_header(reader, hash, binsize) && binsize == (uint64_t)size) {
+				if (lookup)
+					program = lookup(hash);
+				if (program)
+					return program;
+				std::shared_ptr<RuleProgram> loaded = std::make_shared<RuleProgram>();
+				if (loaded->load_binary(bin)) {
+					QMM_WRITEQMMLOG(QMMLOG_DEBUG, "Loaded binary rule file for \"%s\".\n", file.c_str());
+					return loaded;
+				}
+			}
+			QMM_WRITEQMMLOG(QMMLOG_DEBUG, "Binary rule file for \"%s\" is out of date, compiling config.\n", file.c_str());
+		}
+	}
+
+	// read entire file. reading and hashing is cheap compared to compiling
+	std::string buf;
+	if (!s_read_file(file, buf))
+		return nullptr;
+
+	uint64_t hash = hash_fnv1a(buf);
+	if (lookup)
+		program = lookup(hash);
+	if (!program)
+		program = s_compile(buf, hash);
+	return program;
+}
+
+
+// return the compiled config for a file without caching it or logging its warnings
+std::shared_ptr<const RuleProgram> RuleProgram::load_file(const std::string& file) {
+	return s_load_file(file, nullptr);
+}
+
+
+// return the compiled config for a file, or nullptr if it couldn't be loaded. compiled configs are
+// cached for the life of the process by path and content hash, and only recompiled if the file changes
+std::shared_ptr<const RuleProgram> RuleProgram::load(const std::string& file) {
+	// file is unchanged since it was last compiled. if it is still being compiled in the background, compile
+	// it here instead of waiting for the files ahead of it
+	auto lookup = [&file](uint64_t hash) -> std::shared_ptr<const RuleProgram> {
+		auto iter = s_programs.find(file);
+		if (iter == s_programs.end() || iter->second.hash != hash)
+			return nullptr;
+		CachedProgram& cached = iter->second;
+		if (cached.program.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return nullptr;
+		// a background compile that failed is compiled again
+		try {
+			std::shared_ptr<const RuleProgram> program = cached.program.get();
+			QMM_WRITEQMMLOG(QMMLOG_DEBUG, "Using cached compiled config for \"%s\".\n", file.c_str());
+			return program;
+		}
+		catch (std::exception&) {
+			return nullptr;
+		}
+	};
+
+	std::shared_ptr<const RuleProgram> program = s_load_file(file, lookup);
+	if (!program) {
+		QMM_WRITEQMMLOG(QMMLOG_WARNING, "Failed to open file \"%s\" for reading.\n", file.c_str());
+		return nullptr;
+	}
+
+	std::promise<std::shared_ptr<const RuleProgram>> promise;
+	promise.set_value(program);
+	s_programs[file] = { program->hash, promise.get_future().share(), true };
+
+	// warnings are logged every time the config is loaded, just like when it was parsed each time
+	s_log_warnings(file, *program);
+	return program;
+}
+
+
+// read config files and start compiling them on a background thread
+void RuleProgram::precompile(const std::vector<std::string>& files) {
+	// only 1 background compile at a time
+	RuleProgram::wait_precompile();
+
+	auto jobs = std::make_shared<std::vector<PrecompileJob>>();
+	for (auto& file : files) {
+		std::string buf;
+		if (!s_read_file(file, buf))
+			continue;
+		uint64_t hash = hash_fnv1a(buf);
+
+		// already compiled
+		auto iter = s_programs.find(file);
+		if (iter != s_programs.end() && iter->second.hash == hash)
+			continue;
+
+		// binary rule files are read here since the engine can only be used from this thread, and are quick to
+		// load anyway
+		std::shared_ptr<const RuleProgram> binary = s_load_binary(file, hash);
+		if (binary) {
+			std::promise<std::shared_ptr<const RuleProgram>> promise;
+			promise.set_value(binary);
+			s_programs[file] = { hash, promise.get_future().share(), false };
+			s_precompile_pending.push_back(file);
+			continue;
+		}
+
+		jobs->emplace_back();
+		PrecompileJob& job = jobs->back();
+		job.text = std::move(buf);
+		job.hash = hash;
+		s_programs[file] = { hash, job.promise.get_future().share(), false };
+		s_precompile_pending.push_back(file);
+	}
+
+	if (jobs->empty())
+		return;
+
+	QMM_WRITEQMMLOG(QMMLOG_INFO, "Compiling %d configs in the background\n", (int)jobs->size());
+
+	// compiling doesn't use the engine, so it is safe to do on another thread. every promise must be set, or the
+	// files after a failed one would never be ready
+	s_precompile_task = std::async(std::launch::async, [jobs] {
+		for (auto& job : *jobs) {
+			try {
+				job.promise.set_value(s_compile(job.text, job.hash));
+			}
+			catch (...) {
+				job.promise.set_exception(std::current_exception());
+			}
+		}
+	});
+}
+
+
+// log warnings for background compiles that have finished
+bool RuleProgram::poll_precompile() {
+	size_t n = 0;
+	for (auto& file : s_precompile_pending) {
+		auto iter = s_programs.find(file);
+		// file was recompiled by load() or precompile(), so it was (or will be) reported there
+		if (iter == s_programs.end() || iter->second.reported)
+			continue;
+		if (iter->second.program.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			s_precompile_pending[n++] = file;
+			continue;
+		}
+		s_report(file, iter->second);
+	}
+	s_precompile_pending.resize(n);
+
+	return !s_precompile_pending.empty();
+}
+
+
+// wait for any background compile to finish
+void RuleProgram::wait_precompile() {
+	if (s_precompile_task.valid())
+		s_precompile_task.wait();
+}
+
+
+// compile a config file and write its binary rule file
+bool RuleProgram::compile_file(const std::string& file) {
+	std::string text;
+	if (!s_read_file(file, text)) {
+		QMM_WRITEQMMLOG(QMMLOG_WARNING, "Failed to open file \"%s\" for reading.\n", file.c_str());
+		return false;
+	}
+
+	std::shared_ptr<const RuleProgram> program = s_compile(text, hash_fnv1a(text));
+	for (auto& warning : program->warnings)
+		QMM_WRITEQMMLOG(QMMLOG_WARNING, "%s: %s", file.c_str(), warning.c_str());
+
+	std::string buf;
+	program->save_binary(buf);
+
+	std::string binfile = RuleProgram::binary_file(file);
+	fileHandle_t f = 0;
+	int ret = (int)g_syscall(G_FS_FOPEN_FILE, binfile.c_str(), &f, FS_WRITE);
+	if (ret < 0 || !f) {
+		QMM_WRITEQMMLOG(QMMLOG_WARNING, "Unable to write binary rule file to %s\n", binfile.c_str());
+		return false;
+	}
+	g_syscall(G_FS_WRITE, buf.data(), (int)buf.size(), f);
+	g_syscall(G_FS_FCLOSE_FILE, f);
+	s_stale_binaries.erase(file);
+	QMM_WRITEQMMLOG(QMMLOG_INFO, "Binary rule file written to %s (%d rules)\n", binfile.c_str(), (int)program->rules.size());
+	return true;
+}
+
+
+// add a printf-style warning message
+void RuleProgram::warn(const char* fmt, ...) {
+	char buf[1024];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+	this->warnings.push_back(buf);
+}
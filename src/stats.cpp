@@ -0,0 +1,163 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+#include "version.h"
+#include <qmmapi.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <algorithm>
+#include "game.h"
+#include "stats.h"
+
+
+// record a new sample
+void RollingStat::add(double value) {
+	this->samples[this->next] = value;
+	this->next = (this->next + 1) % stats_window;
+	this->count++;
+}
+
+
+double RollingStat::min() const {
+	double ret = this->samples[0];
+	for (int i = 1; i < this->size(); i++)
+		if (this->samples[i] < ret)
+			ret = this->samples[i];
+	return ret;
+}
+
+
+double RollingStat::avg() const {
+	if (!this->size())
+		return 0;
+	double total = 0;
+	for (int i = 0; i < this->size(); i++)
+		total += this->samples[i];
+	return total / this->size();
+}
+
+
+double RollingStat::max() const {
+	double ret = this->samples[0];
+	for (int i = 1; i < this->size(); i++)
+		if (this->samples[i] > ret)
+			ret = this->samples[i];
+	return ret;
+}
+
+
+// a named stat. these are kept in the order they were first recorded, which follows the order of the
+// stages in a map load
+struct NamedStat {
+	std::string name;
+	bool is_time;
+	RollingStat stat;
+};
+static std::vector<NamedStat> s_stats;
+
+
+static RollingStat& s_get_stat(const char* name, bool is_time) {
+	for (auto& stat : s_stats)
+		if (stat.name == name)
+			return stat.stat;
+
+	s_stats.push_back({ name, is_time, {} });
+	return s_stats.back().stat;
+}
+
+
+// record time in milliseconds for a stage
+void stats_time(const char* stage, double ms) {
+	s_get_stat(stage, true).add(ms);
+}
+
+
+// record a count (entities, tokens, etc)
+void stats_count(const char* counter, double value) {
+	s_get_stat(counter, false).add(value);
+}
+
+
+// print all stats to the log
+void stats_print() {
+	if (s_stats.empty()) {
+		QMM_WRITEQMMLOG(QMMLOG_NOTICE, "No stats recorded yet.\n");
+		return;
+	}
+
+	QMM_WRITEQMMLOG(QMMLOG_NOTICE, "Stats for the last %d map loads (times in ms):\n", stats_window);
+	QMM_WRITEQMMLOG(QMMLOG_NOTICE, "%-32s %12s %12s %12s %12s %8s\n", "stage", "last", "min", "avg", "max", "samples");
+	for (auto& stat : s_stats) {
+		const RollingStat& s = stat.stat;
+		if (stat.is_time)
+			QMM_WRITEQMMLOG(QMMLOG_NOTICE, "%-32s %12.3f %12.3f %12.3f %12.3f %8d\n", stat.name.c_str(), s.last(), s.min(), s.avg(), s.max(), s.total());
+		else
+			QMM_WRITEQMMLOG(QMMLOG_NOTICE, "%-32s %12.0f %12.0f %12.1f %12.0f %8d\n", stat.name.c_str(), s.last(), s.min(), s.avg(), s.max(), s.total());
+	}
+}
+
+
+static bool s_profile_enabled = false;
+// profiles by file, line, and type
+static std::map<std::tuple<std::string, int, std::string>, BlockProfile> s_profiles;
+
+
+// turn per-block profiling of configs on or off
+void profile_enable(bool enable) {
+	s_profile_enabled = enable;
+}
+
+
+bool profile_enabled() {
+	return s_profile_enabled;
+}
+
+
+// clear all block profiles
+void profile_clear() {
+	s_profiles.clear();
+}
+
+
+// return the profile for a config block, adding it if needed
+BlockProfile* profile_block(const std::string& file, int line, const char* type) {
+	BlockProfile& profile = s_profiles[{ file, line, type }];
+	if (profile.file.empty()) {
+		profile.file = file;
+		profile.line = line;
+		profile.type = type;
+	}
+	return &profile;
+}
+
+
+// print block profiles to the log, most expensive first
+void profile_print() {
+	if (s_profiles.empty()) {
+		QMM_WRITEQMMLOG(QMMLOG_NOTICE, "No config profile recorded. Set stripper_profile to 1 and reload the map.\n");
+		return;
+	}
+
+	std::vector<const BlockProfile*> sorted;
+	for (auto& profile : s_profiles)
+		sorted.push_back(&profile.second);
+	std::stable_sort(sorted.begin(), sorted.end(), [](const BlockProfile* a, const BlockProfile* b) {
+		return a->ms > b->ms;
+	});
+
+	QMM_WRITEQMMLOG(QMMLOG_NOTICE, "Config profile for the last map load (times in ms):\n");
+	QMM_WRITEQMMLOG(QMMLOG_NOTICE, "%12s %12s %10s %10s %10s  %-8s %s\n", "time", "regex time", "tested", "matched", "regexes", "block", "location");
+	for (auto profile : sorted)
+		QMM_WRITEQMMLOG(QMMLOG_NOTICE, "%12.3f %12.3f %10lld %10lld %10lld  %-8s %s:%d\n", profile->ms, profile->regex_ms, (long long)profile->tested, (long long)profile->matched, (long long)profile->regex_tested, profile->type, profile->file.c_str(), profile->line);
+}
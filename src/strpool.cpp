@@ -0,0 +1,72 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+#include <string_view>
+#include <memory>
+
+#include "strpool.h"
+
+// size of each block of string data. strings larger than this get their own block
+static const size_t s_block_size = 64 * 1024;
+
+
+StringPool::StringPool() {
+	// these must match the fixed ids in strpool.h
+	this->intern("");
+	this->intern("classname");
+}
+
+
+// return the id for str, adding it to the pool if needed
+StrId StringPool::intern(std::string_view str) {
+	auto iter = this->ids.find(str);
+	if (iter != this->ids.end())
+		return iter->second;
+
+	// need room for str plus null terminator
+	size_t need = str.size() + 1;
+	char* dest;
+	if (need > s_block_size) {
+		// large string, give it a block of its own (and keep using the current block)
+		this->blocks.emplace(this->blocks.begin(), new char[need]);
+		dest = this->blocks.front().get();
+	}
+	else {
+		if (this->blocks.empty() || this->block_used + need > this->block_size) {
+			this->blocks.emplace_back(new char[s_block_size]);
+			this->block_used = 0;
+			this->block_size = s_block_size;
+		}
+		dest = this->blocks.back().get() + this->block_used;
+		this->block_used += need;
+	}
+
+	memcpy(dest, str.data(), str.size());
+	dest[str.size()] = '\0';
+
+	StrId id = (StrId)this->strings.size();
+	std::string_view stored(dest, str.size());
+	this->strings.push_back(stored);
+	this->ids.emplace(stored, id);
+	return id;
+}
+
+
+// return the id for str, or str_none if it is not in the pool
+StrId StringPool::find(std::string_view str) const {
+	auto iter = this->ids.find(str);
+	if (iter == this->ids.end())
+		return str_none;
+	return iter->second;
+}
@@ -0,0 +1,142 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include "threads.h"
+
+static std::vector<std::thread> s_workers;
+
+// guards everything below except s_job_next
+static std::mutex s_mutex;
+// wakes workers when a new job starts or when they should exit
+static std::condition_variable s_work_cv;
+// wakes the game thread when all workers have finished a job
+static std::condition_variable s_done_cv;
+static bool s_stop = false;
+
+// current job. s_job_id changes for each job so workers know they haven't run it yet
+static uint64_t s_job_id = 0;
+static const std::function<void(size_t, size_t)>* s_job_func = nullptr;
+static size_t s_job_count = 0;
+static size_t s_job_chunk = 0;
+// start of the next chunk to be claimed
+static std::atomic<size_t> s_job_next{ 0 };
+// workers that haven't finished the current job
+static int s_job_active = 0;
+
+
+// stops any workers still running when the process exits (before the mutex and condition variables above are
+// destroyed). the plugin stops them in QMM_Detach, so this is mostly for tools
+static struct ThreadsShutdown {
+	~ThreadsShutdown() { threads_set_count(0); }
+} s_shutdown;
+
+
+// claim and run chunks of the current job until there are none left
+static void s_run_chunks() {
+	while (true) {
+		size_t begin = s_job_next.fetch_add(s_job_chunk);
+		if (begin >= s_job_count)
+			break;
+		(*s_job_func)(begin, std::min(begin + s_job_chunk, s_job_count));
+	}
+}
+
+
+// worker thread main loop. last_job is the id of the last job started before this worker was
+static void s_worker(uint64_t last_job) {
+	std::unique_lock<std::mutex> lock(s_mutex);
+
+	while (true) {
+		s_work_cv.wait(lock, [&] { return s_stop || s_job_id != last_job; });
+		if (s_stop)
+			return;
+		last_job = s_job_id;
+
+		lock.unlock();
+		s_run_chunks();
+		lock.lock();
+
+		if (--s_job_active == 0)
+			s_done_cv.notify_one();
+	}
+}
+
+
+// set the number of worker threads (0 = all work is done on the calling thread)
+void threads_set_count(int count) {
+	count = std::clamp(count, 0, threads_max);
+	if (count == (int)s_workers.size())
+		return;
+
+	// stop all existing workers
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_stop = true;
+	}
+	s_work_cv.notify_all();
+	for (auto& worker : s_workers)
+		worker.join();
+	s_workers.clear();
+
+	// start new workers
+	s_stop = false;
+	for (int i = 0; i < count; i++)
+		s_workers.emplace_back(s_worker, s_job_id);
+}
+
+
+// return the number of worker threads
+int threads_get_count() {
+	return (int)s_workers.size();
+}
+
+
+// split [0, count) into chunks and call func on each chunk, using the worker threads and the calling thread
+void threads_for(size_t count, size_t min_chunk, const std::function<void(size_t, size_t)>& func) {
+	if (!count)
+		return;
+
+	size_t num_threads = s_workers.size() + 1;
+
+	// not worth waking up the workers
+	if (num_threads == 1 || count < min_chunk * 2) {
+		func(0, count);
+		return;
+	}
+
+	// a few chunks per thread, so threads that finish early can pick up more work
+	size_t chunk = std::max(min_chunk, count / (num_threads * 4));
+
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_job_func = &func;
+		s_job_count = count;
+		s_job_chunk = chunk;
+		s_job_next = 0;
+		s_job_active = (int)s_workers.size();
+		s_job_id++;
+	}
+	s_work_cv.notify_all();
+
+	// help out while waiting
+	s_run_chunks();
+
+	std::unique_lock<std::mutex> lock(s_mutex);
+	s_done_cv.wait(lock, [] { return s_job_active == 0; });
+	s_job_func = nullptr;
+}
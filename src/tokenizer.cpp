@@ -0,0 +1,189 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+#include <string.h>
+#include <string>
+#include <string_view>
+
+// SSE2 is always available on x86_64. 32-bit builds use the scalar code
+#if defined(__SSE2__) || defined(_M_X64)
+#define STRIPPER_TOKENIZER_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#include "tokenizer.h"
+
+
+// whitespace ends a token
+static inline bool s_is_space(unsigned char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+
+// non-printable characters are skipped entirely (this includes any byte >= 127)
+static inline bool s_is_skip(unsigned char c) {
+	return c < ' ' || c >= 127;
+}
+
+
+#ifdef STRIPPER_TOKENIZER_SSE2
+// return the index of the lowest set bit in a non-zero mask
+static inline int s_first_bit(unsigned int mask) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+
+// return a bitmask of the bytes in a 16-byte block that are whitespace or non-printable (anything outside
+// of '!' to '~'). bytes are compared as signed, so any byte >= 128 is also less than '!'
+static inline unsigned int s_mask_space_or_skip(__m128i block) {
+	__m128i low = _mm_cmplt_epi8(block, _mm_set1_epi8('!'));
+	__m128i del = _mm_cmpeq_epi8(block, _mm_set1_epi8(127));
+	return (unsigned int)_mm_movemask_epi8(_mm_or_si128(low, del));
+}
+#endif
+
+
+// return the position of the first printable non-whitespace char at or after pos, or size if there isn't one
+static inline size_t s_skip_space(const char* data, size_t pos, size_t size) {
+#ifdef STRIPPER_TOKENIZER_SSE2
+	// most gaps between tokens are only a char or two (like "\" \"" or "\"\n\""), so check those first
+	for (size_t end = pos + 2; pos < end && pos < size; pos++) {
+		if (!s_is_space(data[pos]) && !s_is_skip(data[pos]))
+			return pos;
+	}
+	while (pos + 16 <= size) {
+		__m128i block = _mm_loadu_si128((const __m128i*)(data + pos));
+		unsigned int mask = ~s_mask_space_or_skip(block) & 0xFFFF;
+		if (mask)
+			return pos + s_first_bit(mask);
+		pos += 16;
+	}
+#endif
+	while (pos < size && (s_is_space(data[pos]) || s_is_skip(data[pos])))
+		pos++;
+	return pos;
+}
+
+
+// return the position of the first char at or after pos that may end an unquoted token (whitespace, a brace,
+// or a quote) or must be stripped from it (non-printable), or size if there isn't one
+static inline size_t s_find_special(const char* data, size_t pos, size_t size) {
+#ifdef STRIPPER_TOKENIZER_SSE2
+	while (pos + 16 <= size) {
+		__m128i block = _mm_loadu_si128((const __m128i*)(data + pos));
+		__m128i open = _mm_cmpeq_epi8(block, _mm_set1_epi8('{'));
+		__m128i close = _mm_cmpeq_epi8(block, _mm_set1_epi8('}'));
+		__m128i quote = _mm_cmpeq_epi8(block, _mm_set1_epi8('"'));
+		unsigned int mask = s_mask_space_or_skip(block) | (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(open, close), quote));
+		if (mask)
+			return pos + s_first_bit(mask);
+		pos += 16;
+	}
+#endif
+	while (pos < size) {
+		unsigned char u = data[pos];
+		if (s_is_space(u) || s_is_skip(u) || u == '{' || u == '}' || u == '"')
+			break;
+		pos++;
+	}
+	return pos;
+}
+
+
+// return the position of the first quote at or after pos, or size if there isn't one
+static inline size_t s_find_quote(const char* data, size_t pos, size_t size) {
+#ifdef STRIPPER_TOKENIZER_SSE2
+	// most quoted tokens are short, so this usually finishes with 1 compare and avoids a call to memchr
+	while (pos + 16 <= size) {
+		__m128i block = _mm_loadu_si128((const __m128i*)(data + pos));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('"')));
+		if (mask)
+			return pos + s_first_bit(mask);
+		pos += 16;
+	}
+#endif
+	const void* quote = memchr(data + pos, '"', size - pos);
+	return quote ? (const char*)quote - data : size;
+}
+
+
+Tokenizer::Tokenizer(std::string_view src) : src(src) { }
+
+
+// get the next token, returns false if there are no more tokens
+bool Tokenizer::next(std::string_view& token) {
+	const size_t size = this->src.size();
+	const char* data = this->src.data();
+
+	// skip whitespace and non-printable characters between tokens
+	this->pos = s_skip_space(data, this->pos, size);
+
+	if (this->pos >= size)
+		return false;
+
+	char c = data[this->pos];
+
+	// braces are always a token on their own
+	if (c == '{' || c == '}') {
+		token = this->src.substr(this->pos, 1);
+		this->pos++;
+		return true;
+	}
+
+	// quotes: scan forward until next quote and return whole string as 1 token
+	if (c == '"') {
+		size_t start = this->pos + 1;
+		size_t end = s_find_quote(data, start, size);
+		token = this->src.substr(start, end - start);
+		// skip closing quote
+		this->pos = end + 1;
+		return true;
+	}
+
+	// unquoted token: ends at whitespace, a brace, or a quote
+	size_t start = this->pos;
+	bool has_skip = false;
+	while (true) {
+		this->pos = s_find_special(data, this->pos, size);
+		if (this->pos >= size)
+			break;
+		unsigned char u = data[this->pos];
+		if (s_is_space(u) || u == '{' || u == '}' || u == '"')
+			break;
+		// non-printable, keep going
+		has_skip = true;
+		this->pos++;
+	}
+
+	// common case: return a view directly into the source
+	if (!has_skip) {
+		token = this->src.substr(start, this->pos - start);
+		return true;
+	}
+
+	// rare case: non-printable characters inside the token are stripped, so build a copy
+	this->scratch.clear();
+	for (size_t i = start; i < this->pos; i++) {
+		if (!s_is_skip(data[i]))
+			this->scratch += data[i];
+	}
+	token = this->scratch;
+	return true;
+}
@@ -14,6 +14,7 @@ Created By:
 #include <qmmapi.h>
 #include <cstring>
 #include <string>
+#include <string_view>
 #include "game.h"
 #include "util.h"
 
@@ -36,8 +37,27 @@ int str_stricmp(std::string s1, std::string s2) {
 }
 
 
-int str_striequal(std::string s1, std::string s2) {
-	return str_stricmp(s1, s2) == 0;
+// compares in place so that neither string needs to be copied
+int str_striequal(std::string_view s1, std::string_view s2) {
+	if (s1.size() != s2.size())
+		return 0;
+
+	for (size_t i = 0; i < s1.size(); i++) {
+		if (std::tolower((unsigned char)s1[i]) != std::tolower((unsigned char)s2[i]))
+			return 0;
+	}
+
+	return 1;
+}
+
+
+// 64-bit FNV-1a hash of data, optionally continuing from a previous hash
+uint64_t hash_fnv1a(std::string_view data, uint64_t hash) {
+	for (auto c : data) {
+		hash ^= (unsigned char)c;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
 }
 
 
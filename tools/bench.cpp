@@ -0,0 +1,285 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+// benchmark for Stripper's entity loading, config application, and output, using the stub engine in
+// mock_engine.cpp. build with "make bench" and run bin/bench/stripper_bench with no args for usage
+
+#include "version.h"
+#include <qmmapi.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+#include "game.h"
+#include "ent.h"
+#include "mock_engine.h"
+#include "threads.h"
+
+// config file path used for the generated config
+static const char* s_config_file = "bench.ini";
+// file path used for dump_to_file
+static const char* s_dump_file = "bench_dump.txt";
+
+// options
+struct BenchOptions {
+	std::string mapfile;		// real entity dump to load (or generate a map if empty)
+	std::string configfile;		// real config to apply (or generate a config if empty)
+	int ents = 10000;			// number of entities in generated map
+	int filters = 100;			// number of exact "filter" entities in generated config
+	int regexes = 10;			// number of regex "filter" entities in generated config
+	int adds = 10;				// number of "add" entities in generated config
+	int replaces = 10;			// number of "replace"/"with" pairs in generated config
+	int iterations = 10;
+	unsigned int seed = 1;
+	int threads = 0;			// worker threads for matching
+};
+
+// timings for a single stage
+struct StageTimes {
+	const char* name;
+	double first = 0, min = 0, total = 0;
+	int count = 0;
+
+	void add(double ms) {
+		if (!this->count || ms < this->min)
+			this->min = ms;
+		if (!this->count)
+			this->first = ms;
+		this->total += ms;
+		this->count++;
+	}
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double s_ms_since(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+static const char* s_classnames[] = {
+	"info_player_deathmatch", "weapon_rocketlauncher", "weapon_railgun", "weapon_plasmagun", "weapon_shotgun",
+	"item_armor_combat", "item_armor_shard", "item_health", "item_health_large", "item_quad", "ammo_rockets",
+	"ammo_slugs", "ammo_cells", "light", "func_door", "func_plat", "trigger_multiple", "trigger_teleport",
+	"target_position", "misc_teleporter_dest", "misc_model",
+};
+static const size_t s_num_classnames = sizeof(s_classnames) / sizeof(s_classnames[0]);
+
+
+// generate an entstring with a worldspawn and num_ents - 1 random entities
+static std::string s_gen_map(int num_ents, std::mt19937& rng, std::vector<std::string>& origins) {
+	std::string entstring = "{\n\"classname\" \"worldspawn\"\n\"message\" \"Stripper Benchmark\"\n}\n";
+
+	for (int i = 1; i < num_ents; i++) {
+		std::string origin = std::to_string((int)(rng() % 8192) - 4096) + " " + std::to_string((int)(rng() % 8192) - 4096) + " " + std::to_string((int)(rng() % 1024));
+		origins.push_back(origin);
+
+		entstring += "{\n\"classname\" \"";
+		entstring += s_classnames[rng() % s_num_classnames];
+		entstring += "\"\n\"origin\" \"" + origin + "\"\n";
+		if (rng() % 2)
+			entstring += "\"angle\" \"" + std::to_string(rng() % 360) + "\"\n";
+		if (rng() % 4 == 0)
+			entstring += "\"spawnflags\" \"" + std::to_string(rng() % 8) + "\"\n";
+		if (rng() % 4 == 0)
+			entstring += "\"targetname\" \"t" + std::to_string(rng() % 1000) + "\"\n";
+		if (rng() % 8 == 0)
+			entstring += "\"target\" \"t" + std::to_string(rng() % 1000) + "\"\n";
+		entstring += "}\n";
+	}
+
+	return entstring;
+}
+
+
+// generate a config with filters by origin (like a typical anti-camping config), regex filters, adds, and replaces
+static std::string s_gen_config(const BenchOptions& opts, std::mt19937& rng, const std::vector<std::string>& origins) {
+	std::string config;
+
+	config += "filter:\n";
+	for (int i = 0; i < opts.filters && !origins.empty(); i++)
+		config += "{\n\"origin\" \"" + origins[rng() % origins.size()] + "\"\n}\n";
+	for (int i = 0; i < opts.regexes; i++)
+		config += "{\n\"classname\" \"/ammo_.*/\"\n\"targetname\" \"/t" + std::to_string(rng() % 100) + "[0-9]/\"\n}\n";
+
+	config += "add:\n";
+	for (int i = 0; i < opts.adds; i++)
+		config += "{\n\"classname\" \"item_quad\"\n\"origin\" \"" + std::to_string(i * 64) + " 0 0\"\n}\n";
+
+	for (int i = 0; i < opts.replaces; i++) {
+		config += "replace:\n{\n\"classname\" \"";
+		config += s_classnames[rng() % s_num_classnames];
+		config += "\"\n}\nwith:\n{\n\"spawnflags\" \"" + std::to_string(i) + "\"\n}\n";
+	}
+
+	return config;
+}
+
+
+static bool s_read_file(const std::string& path, std::string& contents) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		return false;
+	std::stringstream ss;
+	ss << in.rdbuf();
+	contents = ss.str();
+	return true;
+}
+
+
+static void s_usage(const char* argv0) {
+	printf("Stripper v" STRIPPER_QMM_VERSION " benchmark\n");
+	printf("Usage: %s [options]\n", argv0);
+	printf("  --map <file>      load entities from an entity dump instead of generating a map\n");
+	printf("  --config <file>   apply a config file instead of generating a config\n");
+	printf("  --ents <n>        number of entities in generated map (default 10000)\n");
+	printf("  --filters <n>     number of filters by origin in generated config (default 100)\n");
+	printf("  --regexes <n>     number of regex filters in generated config (default 10)\n");
+	printf("  --adds <n>        number of adds in generated config (default 10)\n");
+	printf("  --replaces <n>    number of replace/with pairs in generated config (default 10)\n");
+	printf("  --iterations <n>  number of times to run each stage (default 10)\n");
+	printf("  --seed <n>        random seed for generated map and config (default 1)\n");
+	printf("  --threads <n>     worker threads for matching, like stripper_threads (default 0)\n");
+}
+
+
+static bool s_parse_args(int argc, char** argv, BenchOptions& opts) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc)
+			return false;
+		const char* val = argv[++i];
+
+		if (arg == "--map")
+			opts.mapfile = val;
+		else if (arg == "--config")
+			opts.configfile = val;
+		else if (arg == "--ents")
+			opts.ents = atoi(val);
+		else if (arg == "--filters")
+			opts.filters = atoi(val);
+		else if (arg == "--regexes")
+			opts.regexes = atoi(val);
+		else if (arg == "--adds")
+			opts.adds = atoi(val);
+		else if (arg == "--replaces")
+			opts.replaces = atoi(val);
+		else if (arg == "--iterations")
+			opts.iterations = atoi(val);
+		else if (arg == "--seed")
+			opts.seed = (unsigned int)strtoul(val, nullptr, 10);
+		else if (arg == "--threads")
+			opts.threads = atoi(val);
+		else
+			return false;
+	}
+	return opts.iterations > 0;
+}
+
+
+int main(int argc, char** argv) {
+	BenchOptions opts;
+	if (argc < 2 || !s_parse_args(argc, argv, opts)) {
+		s_usage(argv[0]);
+		return 1;
+	}
+
+	threads_set_count(opts.threads);
+
+	std::mt19937 rng(opts.seed);
+	std::vector<std::string> origins;
+
+	// load or generate entities
+	std::string entstring;
+	if (!opts.mapfile.empty()) {
+		if (!s_read_file(opts.mapfile, entstring)) {
+			fprintf(stderr, "Unable to read map file %s\n", opts.mapfile.c_str());
+			return 1;
+		}
+	}
+	else {
+		entstring = s_gen_map(opts.ents, rng, origins);
+	}
+	mock_set_entstring(entstring);
+
+	// load or generate config. a real config is read from disk by the stub engine
+	std::string configfile = opts.configfile;
+	if (configfile.empty()) {
+		configfile = s_config_file;
+		mock_set_file(configfile, s_gen_config(opts, rng, origins));
+	}
+
+	StageTimes pull{ "token pull" }, parse{ "pull + parse" }, copy{ "copy" }, apply{ "apply_config" },
+		entstr{ "get_entstring" }, tokens{ "get_next_token" }, dump{ "dump_to_file" };
+	size_t num_mapents = 0, num_modents = 0, num_tokens = 0;
+
+	for (int i = 0; i < opts.iterations; i++) {
+		// raw cost of pulling tokens from the engine
+		mock_rewind_tokens();
+		char buf[MAX_TOKEN_CHARS];
+		Clock::time_point start = Clock::now();
+		while (g_syscall(G_GET_ENTITY_TOKEN, buf, sizeof(buf)))
+			;
+		pull.add(s_ms_since(start));
+
+		// each iteration gets a fresh pool, like a new map load
+		MapEntities mapents(std::make_shared<StringPool>());
+		mock_rewind_tokens();
+		start = Clock::now();
+		mapents.make_from_engine();
+		parse.add(s_ms_since(start));
+		num_mapents = mapents.get_entlist().size();
+
+		start = Clock::now();
+		MapEntities modents = mapents;
+		copy.add(s_ms_since(start));
+
+		// the first iteration includes compiling the config, later iterations use the compiled config
+		start = Clock::now();
+		modents.apply_config(configfile);
+		apply.add(s_ms_since(start));
+		num_modents = modents.get_entlist().size();
+
+		start = Clock::now();
+		modents.get_entstring();
+		entstr.add(s_ms_since(start));
+
+		// apply_config above reset the token cursor to the first token
+		num_tokens = 0;
+		start = Clock::now();
+		while (modents.get_next_token(buf, sizeof(buf)))
+			num_tokens++;
+		tokens.add(s_ms_since(start));
+
+		start = Clock::now();
+		modents.dump_to_file(s_dump_file);
+		dump.add(s_ms_since(start));
+	}
+
+	printf("Stripper v" STRIPPER_QMM_VERSION " benchmark\n");
+	printf("map: %s, %zu entities in, %zu entities out, %zu tokens out\n", opts.mapfile.empty() ? "generated" : opts.mapfile.c_str(), num_mapents, num_modents, num_tokens);
+	printf("config: %s\n", opts.configfile.empty() ? "generated" : opts.configfile.c_str());
+	printf("iterations: %d, threads: %d\n\n", opts.iterations, threads_get_count());
+
+	printf("%-16s %12s %12s %12s\n", "stage", "first (ms)", "min (ms)", "avg (ms)");
+	for (StageTimes* stage : { &pull, &parse, &copy, &apply, &entstr, &tokens, &dump })
+		printf("%-16s %12.3f %12.3f %12.3f\n", stage->name, stage->first, stage->min, stage->total / stage->count);
+
+	threads_set_count(0);
+
+	return 0;
+}
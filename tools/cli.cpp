@@ -0,0 +1,291 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+// offline tool that applies Stripper configs to entity dumps (in stripper_dump format) without a game server,
+// using the stub engine in mock_engine.cpp for file access. maps are processed in parallel. build with "make cli"
+// and run bin/cli/stripper_cli with no args for usage. a dump doesn't mark where its SubBSP entity lists start, so
+// configs are applied once to all of a dump's entities, not once per SubBSP list like in the plugin
+
+#include "version.h"
+#include <qmmapi.h>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <filesystem>
+
+#include "game.h"
+#include "ent.h"
+#include "rules.h"
+#include "mock_engine.h"
+
+// options
+struct CliOptions {
+	std::vector<std::string> inputs;			// entity dumps, or directories of them
+	std::string configdir = "qmmaddons/stripper";	// directory with global.ini and maps/
+	std::string outdir = "stripper_out";
+	int jobs = 0;								// maps processed at once (0 = one per core)
+	bool verbose = false;
+	bool compile = false;						// write binary rule files for the configs instead
+};
+
+// a single map to process
+struct MapJob {
+	std::string mapname;
+	std::string file;
+
+	// results
+	bool ok = false;
+	size_t ents_in = 0, ents_out = 0;
+	double ms = 0;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double s_ms_since(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+// dumps written by stripper_dump that aren't a map's original entities
+static const char* s_skip_suffixes[] = { "_modents.txt", "_delta.txt", "_test.txt" };
+
+
+// returns true if str ends with suffix
+static bool s_ends_with(const std::string& str, const std::string& suffix) {
+	return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+
+// read a whole file through the engine's file functions. returns false if it can't be opened
+static bool s_read_file(const std::string& path, std::string& contents) {
+	fileHandle_t f = 0;
+	intptr_t size = g_syscall(G_FS_FOPEN_FILE, path.c_str(), &f, FS_READ);
+	if (size < 0 || !f)
+		return false;
+	contents.resize(size);
+	if (size > 0)
+		g_syscall(G_FS_READ, contents.data(), (int)size, f);
+	g_syscall(G_FS_FCLOSE_FILE, f);
+	return true;
+}
+
+
+// load a config the same way the plugin does, logging any warnings. returns nullptr if the file doesn't exist
+static std::shared_ptr<const RuleProgram> s_load_config(const std::string& file) {
+	std::shared_ptr<const RuleProgram> program = RuleProgram::load_file(file);
+	if (program) {
+		for (auto& warning : program->warnings)
+			QMM_WRITEQMMLOG(QMMLOG_WARNING, "%s: %s", file.c_str(), warning.c_str());
+	}
+	return program;
+}
+
+
+// load a map's entities, apply the global config and its map config, and write the result. this is called from
+// several threads at once, so it only uses its own MapEntities and the stub engine's file functions
+static void s_process(const CliOptions& opts, const RuleProgram* globalcfg, MapJob& job) {
+	Clock::time_point start = Clock::now();
+
+	std::string entstring;
+	if (!s_read_file(job.file, entstring)) {
+		QMM_WRITEQMMLOG(QMMLOG_ERROR, "Unable to read %s\n", job.file.c_str());
+		return;
+	}
+
+	// each map gets its own pool, like a new map load
+	MapEntities mapents(std::make_shared<StringPool>());
+	mapents.make_from_entstring(entstring);
+	job.ents_in = mapents.get_entlist().size();
+
+	MapEntities modents = mapents;
+	if (globalcfg)
+		modents.apply_config(*globalcfg, opts.configdir + "/global.ini");
+
+	std::string mapfile = opts.configdir + "/maps/" + job.mapname + ".ini";
+	std::shared_ptr<const RuleProgram> mapcfg = s_load_config(mapfile);
+	if (mapcfg)
+		modents.apply_config(*mapcfg, mapfile);
+	job.ents_out = modents.get_entlist().size();
+
+	std::string buf;
+	modents.dump_to_buffer(buf);
+	MapEntities::write_dump(opts.outdir + "/" + job.mapname + ".txt", buf);
+
+	job.ok = true;
+	job.ms = s_ms_since(start);
+}
+
+
+// write binary rule files for global.ini and every config in maps/. returns the number that failed
+static int s_compile_configs(const CliOptions& opts) {
+	std::vector<std::string> files = { opts.configdir + "/global.ini" };
+	std::error_code error;
+	std::vector<std::string> mapfiles;
+	for (auto& entry : std::filesystem::directory_iterator(opts.configdir + "/maps", error)) {
+		if (entry.is_regular_file(error) && s_ends_with(entry.path().filename().string(), ".ini"))
+			mapfiles.push_back(entry.path().string());
+	}
+	std::sort(mapfiles.begin(), mapfiles.end());
+	files.insert(files.end(), mapfiles.begin(), mapfiles.end());
+
+	int failed = 0;
+	for (auto& file : files) {
+		if (!RuleProgram::compile_file(file))
+			failed++;
+	}
+	printf("%d configs compiled, %d failed\n", (int)files.size() - failed, failed);
+	return failed;
+}
+
+
+// find all entity dumps in the inputs
+static bool s_find_maps(const CliOptions& opts, std::vector<MapJob>& jobs) {
+	for (auto& input : opts.inputs) {
+		std::error_code error;
+		std::vector<std::filesystem::path> files;
+
+		if (std::filesystem::is_directory(input, error)) {
+			for (auto& entry : std::filesystem::directory_iterator(input, error)) {
+				std::string name = entry.path().filename().string();
+				if (!entry.is_regular_file(error) || !s_ends_with(name, ".txt"))
+					continue;
+				if (std::any_of(std::begin(s_skip_suffixes), std::end(s_skip_suffixes), [&name](const char* suffix) { return s_ends_with(name, suffix); }))
+					continue;
+				files.push_back(entry.path());
+			}
+			// directory order is unspecified
+			std::sort(files.begin(), files.end());
+		}
+		else if (std::filesystem::is_regular_file(input, error)) {
+			files.push_back(input);
+		}
+		else {
+			fprintf(stderr, "Unable to find %s\n", input.c_str());
+			return false;
+		}
+
+		for (auto& file : files) {
+			MapJob job;
+			job.mapname = file.stem().string();
+			job.file = file.string();
+			jobs.push_back(std::move(job));
+		}
+	}
+	return true;
+}
+
+
+static void s_usage(const char* argv0) {
+	printf("Stripper v" STRIPPER_QMM_VERSION " command line tool\n");
+	printf("Usage: %s [options] <dump or directory>...\n", argv0);
+	printf("       %s -b [-c <dir>]\n", argv0);
+	printf("Applies global.ini and maps/{mapname}.ini to entity dumps made with stripper_dump ({mapname}.txt), and\n");
+	printf("writes the results to the output directory in the same format. SubBSP entity lists in a dump can't be told\n");
+	printf("apart, so each config is applied once to all of a dump's entities.\n");
+	printf("  -c <dir>   config directory with global.ini and maps/ (default qmmaddons/stripper)\n");
+	printf("  -o <dir>   output directory (default stripper_out)\n");
+	printf("  -j <n>     number of maps to process at once (default: one per core)\n");
+	printf("  -v         log what each config changed\n");
+	printf("  -b         write binary rule files ({name}.bin) next to global.ini and maps/*.ini, which are loaded\n");
+	printf("             instead of the configs while they keep the same size (run again after editing a config)\n");
+}
+
+
+static bool s_parse_args(int argc, char** argv, CliOptions& opts) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-v") {
+			opts.verbose = true;
+			continue;
+		}
+		if (arg == "-b") {
+			opts.compile = true;
+			continue;
+		}
+		if (arg.size() < 2 || arg[0] != '-') {
+			opts.inputs.push_back(arg);
+			continue;
+		}
+		if (i + 1 >= argc)
+			return false;
+		const char* val = argv[++i];
+
+		if (arg == "-c")
+			opts.configdir = val;
+		else if (arg == "-o")
+			opts.outdir = val;
+		else if (arg == "-j")
+			opts.jobs = atoi(val);
+		else
+			return false;
+	}
+	return opts.compile || !opts.inputs.empty();
+}
+
+
+int main(int argc, char** argv) {
+	CliOptions opts;
+	if (argc < 2 || !s_parse_args(argc, argv, opts)) {
+		s_usage(argv[0]);
+		return 1;
+	}
+
+	mock_set_disk_writes(true);
+	mock_set_log_level(opts.verbose ? QMMLOG_INFO : QMMLOG_WARNING);
+
+	if (opts.compile)
+		return s_compile_configs(opts) ? 1 : 0;
+
+	std::vector<MapJob> jobs;
+	if (!s_find_maps(opts, jobs))
+		return 1;
+
+	int num_threads = opts.jobs > 0 ? opts.jobs : (int)std::thread::hardware_concurrency();
+	num_threads = std::clamp(num_threads, 1, std::max((int)jobs.size(), 1));
+
+	Clock::time_point start = Clock::now();
+
+	// the global config is the same for every map, so only compile it once
+	std::shared_ptr<const RuleProgram> globalcfg = s_load_config(opts.configdir + "/global.ini");
+
+	// each thread takes the next map until there are none left. maps are independent, so matching within a map
+	// stays on its thread
+	std::atomic<size_t> next{ 0 };
+	auto worker = [&] {
+		for (size_t i = next++; i < jobs.size(); i = next++)
+			s_process(opts, globalcfg.get(), jobs[i]);
+	};
+	std::vector<std::thread> threads;
+	for (int i = 1; i < num_threads; i++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto& thread : threads)
+		thread.join();
+
+	double total_ms = s_ms_since(start);
+
+	int failed = 0;
+	for (auto& job : jobs) {
+		if (job.ok)
+			printf("%s: %zu entities in, %zu entities out (%.3f ms)\n", job.mapname.c_str(), job.ents_in, job.ents_out, job.ms);
+		else
+			failed++;
+	}
+	printf("\n%d maps processed, %d failed, in %.3f ms with %d threads\n", (int)(jobs.size() - failed), failed, total_ms, num_threads);
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,52 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+// stand-in for a game SDK, used with GAME_MOCK to build Stripper's entity code outside of QMM (see
+// tools/mock_engine.cpp). this only has the parts of a game SDK used by src/ (other than main.cpp)
+
+#ifndef STRIPPER_QMM_MOCK_GAME_MOCK_H
+#define STRIPPER_QMM_MOCK_GAME_MOCK_H
+
+#define MAX_TOKEN_CHARS 1024
+
+typedef int fileHandle_t;
+
+typedef enum {
+    FS_READ,
+    FS_WRITE,
+    FS_APPEND,
+    FS_APPEND_SYNC,
+} fsMode_t;
+
+#define CVAR_ARCHIVE    0x0001
+#define CVAR_SERVERINFO 0x0004
+#define CVAR_ROM        0x0040
+#define CVAR_NORESTART  0x0400
+
+// engine functions
+enum {
+    G_PRINT,
+    G_CVAR_REGISTER,
+    G_FS_FOPEN_FILE,
+    G_FS_READ,
+    G_FS_WRITE,
+    G_FS_FCLOSE_FILE,
+    G_GET_ENTITY_TOKEN,
+};
+
+// mod functions
+enum {
+    GAME_INIT,
+    GAME_SHUTDOWN,
+    GAME_CONSOLE_COMMAND,
+};
+
+#endif // STRIPPER_QMM_MOCK_GAME_MOCK_H
@@ -0,0 +1,48 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+// stand-in for QMM's qmmapi.h, used to build Stripper's entity code outside of QMM (see tools/mock_engine.cpp).
+// this only has the parts of the QMM API used by src/ (other than main.cpp)
+
+#ifndef STRIPPER_QMM_MOCK_QMMAPI_H
+#define STRIPPER_QMM_MOCK_QMMAPI_H
+
+#include <cstdint>
+
+#define C_DLLEXPORT extern "C"
+
+typedef intptr_t (*eng_syscall)(intptr_t cmd, ...);
+
+// log severities
+enum {
+    QMMLOG_TRACE,
+    QMMLOG_DEBUG,
+    QMMLOG_INFO,
+    QMMLOG_NOTICE,
+    QMMLOG_WARNING,
+    QMMLOG_ERROR,
+    QMMLOG_FATAL,
+};
+
+// engine syscall function, provided by mock_engine.cpp
+extern eng_syscall g_syscall;
+
+void mock_writeqmmlog(int severity, const char* fmt, ...);
+const char* mock_varargs(const char* fmt, ...);
+const char* mock_getstrcvar(const char* cvar);
+intptr_t mock_getintcvar(const char* cvar);
+
+#define QMM_WRITEQMMLOG(severity, ...)  mock_writeqmmlog(severity, __VA_ARGS__)
+#define QMM_VARARGS(...)                mock_varargs(__VA_ARGS__)
+#define QMM_GETSTRCVAR(cvar)            mock_getstrcvar(cvar)
+#define QMM_GETINTCVAR(cvar)            mock_getintcvar(cvar)
+
+#endif // STRIPPER_QMM_MOCK_QMMAPI_H
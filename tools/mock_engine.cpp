@@ -0,0 +1,303 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+#include <qmmapi.h>
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <filesystem>
+
+#include "game.h"
+#include "mock_engine.h"
+#include "tokenizer.h"
+
+// entstring and tokenizer for G_GET_ENTITY_TOKEN
+static std::string s_entstring;
+static Tokenizer s_tokens(s_entstring);
+
+// guards the files, handles, and cvars below
+static std::mutex s_mutex;
+
+// files stored in memory
+static std::map<std::string, std::string> s_files;
+// write files to disk instead of s_files
+static bool s_disk_writes = false;
+
+// an open file handle
+struct MockFile {
+	std::string path;
+	int mode;
+	std::string data;
+	size_t pos = 0;
+};
+static std::map<fileHandle_t, MockFile> s_handles;
+static fileHandle_t s_next_handle = 1;
+
+static std::map<std::string, std::string> s_cvars;
+
+static int s_log_level = QMMLOG_WARNING;
+
+
+// set the entstring that G_GET_ENTITY_TOKEN tokens are served from, and restart at the first token
+void mock_set_entstring(std::string entstring) {
+	s_entstring = std::move(entstring);
+	mock_rewind_tokens();
+}
+
+
+// restart G_GET_ENTITY_TOKEN at the first token
+void mock_rewind_tokens() {
+	s_tokens = Tokenizer(s_entstring);
+}
+
+
+// store a file in memory
+void mock_set_file(const std::string& path, std::string contents) {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_files[path] = std::move(contents);
+}
+
+
+// return a file stored in memory, or nullptr if it doesn't exist
+const std::string* mock_get_file(const std::string& path) {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	auto iter = s_files.find(path);
+	if (iter == s_files.end())
+		return nullptr;
+	return &iter->second;
+}
+
+
+// remove all files stored in memory
+void mock_clear_files() {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_files.clear();
+}
+
+
+// if set, files are written to disk instead of being stored in memory
+void mock_set_disk_writes(bool enabled) {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_disk_writes = enabled;
+}
+
+
+// set a cvar for QMM_GETSTRCVAR/QMM_GETINTCVAR
+void mock_set_cvar(const std::string& cvar, const std::string& val) {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_cvars[cvar] = val;
+}
+
+
+// only log messages with at least this severity
+void mock_set_log_level(int severity) {
+	s_log_level = severity;
+}
+
+
+// open a file, returns file length for reading or -1 if the file couldn't be opened
+static intptr_t s_fopen_file(const char* path, fileHandle_t* f, int mode) {
+	MockFile file;
+	file.path = path;
+	file.mode = mode;
+
+	std::unique_lock<std::mutex> lock(s_mutex);
+	auto iter = s_files.find(file.path);
+	if (iter != s_files.end()) {
+		if (mode != FS_WRITE)
+			file.data = iter->second;
+	}
+	// not in memory, read from disk
+	else if (mode == FS_READ) {
+		lock.unlock();
+		std::ifstream in(path, std::ios::binary);
+		if (!in) {
+			*f = 0;
+			return -1;
+		}
+		std::stringstream ss;
+		ss << in.rdbuf();
+		file.data = ss.str();
+		lock.lock();
+	}
+	// appending to a file on disk
+	else if (mode != FS_WRITE && s_disk_writes) {
+		std::ifstream in(path, std::ios::binary);
+		std::stringstream ss;
+		ss << in.rdbuf();
+		file.data = ss.str();
+	}
+
+	*f = s_next_handle++;
+	intptr_t size = (intptr_t)file.data.size();
+	s_handles[*f] = std::move(file);
+	return mode == FS_READ ? size : 0;
+}
+
+
+// return an open file, or nullptr if the handle isn't open. only the thread that opened a file uses it, and map
+// nodes don't move, so the file can be used without holding the lock
+static MockFile* s_find_handle(fileHandle_t f) {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	auto iter = s_handles.find(f);
+	if (iter == s_handles.end())
+		return nullptr;
+	return &iter->second;
+}
+
+
+// close a file, storing written files in memory (or on disk)
+static void s_close_file(fileHandle_t f) {
+	std::unique_lock<std::mutex> lock(s_mutex);
+	auto iter = s_handles.find(f);
+	if (iter == s_handles.end())
+		return;
+	MockFile file = std::move(iter->second);
+	s_handles.erase(iter);
+	if (file.mode == FS_READ)
+		return;
+
+	if (!s_disk_writes) {
+		s_files[file.path] = std::move(file.data);
+		return;
+	}
+	lock.unlock();
+
+	std::filesystem::path path(file.path);
+	std::error_code error;
+	if (path.has_parent_path())
+		std::filesystem::create_directories(path.parent_path(), error);
+	std::ofstream out(path, std::ios::binary);
+	out.write(file.data.data(), file.data.size());
+}
+
+
+static intptr_t s_syscall(intptr_t cmd, ...) {
+	va_list args;
+	va_start(args, cmd);
+	intptr_t ret = 0;
+
+	switch (cmd) {
+		case G_PRINT:
+			fputs(va_arg(args, const char*), stdout);
+			break;
+		case G_CVAR_REGISTER:
+			break;
+		case G_GET_ENTITY_TOKEN: {
+			char* buf = va_arg(args, char*);
+			int len = va_arg(args, int);
+			std::string_view token;
+			if (!s_tokens.next(token))
+				break;
+			if (len > 0) {
+				size_t size = std::min(token.size(), (size_t)len - 1);
+				memcpy(buf, token.data(), size);
+				buf[size] = '\0';
+			}
+			ret = 1;
+			break;
+		}
+		case G_FS_FOPEN_FILE: {
+			const char* path = va_arg(args, const char*);
+			fileHandle_t* f = va_arg(args, fileHandle_t*);
+			int mode = va_arg(args, int);
+			ret = s_fopen_file(path, f, mode);
+			break;
+		}
+		case G_FS_READ: {
+			void* buf = va_arg(args, void*);
+			int len = va_arg(args, int);
+			fileHandle_t f = va_arg(args, fileHandle_t);
+			MockFile* handle = s_find_handle(f);
+			if (!handle)
+				break;
+			MockFile& file = *handle;
+			size_t size = std::min((size_t)len, file.data.size() - file.pos);
+			memcpy(buf, file.data.data() + file.pos, size);
+			file.pos += size;
+			ret = (intptr_t)size;
+			break;
+		}
+		case G_FS_WRITE: {
+			const char* buf = va_arg(args, const char*);
+			int len = va_arg(args, int);
+			fileHandle_t f = va_arg(args, fileHandle_t);
+			MockFile* handle = s_find_handle(f);
+			if (!handle)
+				break;
+			handle->data.append(buf, len);
+			ret = len;
+			break;
+		}
+		case G_FS_FCLOSE_FILE: {
+			fileHandle_t f = va_arg(args, fileHandle_t);
+			s_close_file(f);
+			break;
+		}
+	}
+
+	va_end(args);
+	return ret;
+}
+eng_syscall g_syscall = s_syscall;
+
+
+void mock_writeqmmlog(int severity, const char* fmt, ...) {
+	static const char* names[] = { "TRACE", "DEBUG", "INFO", "NOTICE", "WARNING", "ERROR", "FATAL" };
+	if (severity < s_log_level)
+		return;
+
+	// format the whole line first, so lines from different threads don't get mixed together
+	char buf[4096];
+	int len = snprintf(buf, sizeof(buf), "[STRIPPER] %s: ", names[severity]);
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(buf + len, sizeof(buf) - len, fmt, args);
+	va_end(args);
+	fputs(buf, stderr);
+}
+
+
+const char* mock_varargs(const char* fmt, ...) {
+	// rotate through a few buffers so a few results can be used at once (on each thread)
+	thread_local char buf[8][4096];
+	thread_local int index = 0;
+	index = (index + 1) % 8;
+
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(buf[index], sizeof(buf[index]), fmt, args);
+	va_end(args);
+
+	return buf[index];
+}
+
+
+const char* mock_getstrcvar(const char* cvar) {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	auto iter = s_cvars.find(cvar);
+	if (iter == s_cvars.end())
+		return "";
+	return iter->second.c_str();
+}
+
+
+intptr_t mock_getintcvar(const char* cvar) {
+	return atoi(mock_getstrcvar(cvar));
+}
@@ -0,0 +1,42 @@
+/*
+Stripper - Dynamic Map Entity Modification
+Copyright 2004-2026
+https://github.com/thecybermind/stripper_qmm/
+3-clause BSD license: https://opensource.org/license/bsd-3-clause
+
+Created By:
+    Kevin Masterson < k.m.masterson@gmail.com >
+
+*/
+
+#ifndef STRIPPER_QMM_MOCK_ENGINE_H
+#define STRIPPER_QMM_MOCK_ENGINE_H
+
+#include <string>
+
+// a stub engine behind g_syscall for running Stripper's entity code outside of a game server. entity tokens
+// are served from an entstring (like QMM's G_GET_ENTITY_TOKEN polyfill does), and files are stored in memory.
+// files that aren't in memory are read from disk, relative to the current directory. file and log functions
+// can be used from multiple threads at once
+
+// set the entstring that G_GET_ENTITY_TOKEN tokens are served from, and restart at the first token
+void mock_set_entstring(std::string entstring);
+// restart G_GET_ENTITY_TOKEN at the first token
+void mock_rewind_tokens();
+
+// store a file in memory
+void mock_set_file(const std::string& path, std::string contents);
+// return a file stored in memory, or nullptr if it doesn't exist
+const std::string* mock_get_file(const std::string& path);
+// remove all files stored in memory
+void mock_clear_files();
+// if set, files are written to disk (creating any missing directories) instead of being stored in memory
+void mock_set_disk_writes(bool enabled);
+
+// set a cvar for QMM_GETSTRCVAR/QMM_GETINTCVAR
+void mock_set_cvar(const std::string& cvar, const std::string& val);
+
+// only log messages with at least this severity (default QMMLOG_WARNING)
+void mock_set_log_level(int severity);
+
+#endif // STRIPPER_QMM_MOCK_ENGINE_H